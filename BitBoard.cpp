@@ -0,0 +1,451 @@
+#include "BitBoard.h"
+#include "Zobrist.h"
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline int popCount(uint64_t x) { return __builtin_popcountll(x); }
+
+inline int lowestBit(uint64_t x) { return __builtin_ctzll(x); }
+
+inline uint64_t lowBits(int n) { return (1ULL << n) - 1; }
+
+// Packs the bits of `value` selected by `keep` into the low end of the word,
+// preserving their order. With `keep` = the surviving tiles of a column this
+// is exactly gravity for one color layer.
+inline uint64_t compactBits(uint64_t value, uint64_t keep) {
+#ifdef __BMI2__
+  return _pext_u64(value, keep);
+#else
+  // Copy one run of kept bits at a time; a column only has as many runs as
+  // the removal left gaps, so this is usually one or two iterations.
+  uint64_t result = 0;
+  int out = 0;
+  while (keep) {
+    int start = lowestBit(keep);
+    int len = lowestBit(~(keep >> start));
+    result |= ((value >> start) & lowBits(len)) << out;
+    out += len;
+    keep &= ~(lowBits(len) << start);
+  }
+  return result;
+#endif
+}
+
+// Inverse of compactBits: spreads the low bits of `value` back out over the
+// positions selected by `keep` (parallel bit deposit).
+inline uint64_t expandBits(uint64_t value, uint64_t keep) {
+#ifdef __BMI2__
+  return _pdep_u64(value, keep);
+#else
+  uint64_t result = 0;
+  int in = 0;
+  while (keep) {
+    int start = lowestBit(keep);
+    int len = lowestBit(~(keep >> start));
+    result |= ((value >> in) & lowBits(len)) << start;
+    in += len;
+    keep &= ~(lowBits(len) << start);
+  }
+  return result;
+#endif
+}
+
+} // namespace
+
+void BitBoard::load(const vector<vector<char>> &grid) {
+  rows = grid.size();
+  cols = rows > 0 ? grid[0].size() : 0;
+
+  palette.clear();
+  for (const auto &row : grid) {
+    for (char tile : row) {
+      bool known = false;
+      for (char c : palette) {
+        if (c == tile) {
+          known = true;
+          break;
+        }
+      }
+      if (!known)
+        palette.push_back(tile);
+    }
+  }
+  numColors = palette.size();
+
+  colorBits.assign(numColors * cols, 0);
+  occupied.assign(cols, 0);
+  region.assign(cols, 0);
+  unvisited.assign(cols, 0);
+
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      int color = 0;
+      while (palette[color] != grid[i][j])
+        color++;
+      uint64_t bit = 1ULL << bitOf(i);
+      layer(color)[j] |= bit;
+      occupied[j] |= bit;
+    }
+  }
+  activeCols = cols;
+
+  hash = 0;
+  for (int color = 0; color < numColors; color++) {
+    for (int c = 0; c < cols; c++) {
+      hash ^= keysOf(layer(color)[c], c, color);
+    }
+  }
+}
+
+// XOR of the Zobrist keys of every tile of `color` set in `bits`.
+uint64_t BitBoard::keysOf(uint64_t bits, int col, int color) const {
+  uint64_t keys = 0;
+  for (; bits; bits &= bits - 1) {
+    keys ^= zobrist::tileKey(rowOf(lowestBit(bits)), col, palette[color]);
+  }
+  return keys;
+}
+
+int BitBoard::colorAt(int bit, int col) const {
+  uint64_t mask = 1ULL << bit;
+  for (int color = 0; color < numColors; color++) {
+    if (layer(color)[col] & mask)
+      return color;
+  }
+  return -1;
+}
+
+char BitBoard::getTile(int row, int col) const {
+  if (row < 0 || row >= rows || col < 0 || col >= cols)
+    return '\0';
+  int color = colorAt(bitOf(row), col);
+  return color >= 0 ? palette[color] : '\0';
+}
+
+bool BitBoard::isTileActive(int row, int col) const {
+  if (row < 0 || row >= rows || col < 0 || col >= cols)
+    return false;
+  return (occupied[col] >> bitOf(row)) & 1;
+}
+
+// Grows the single tile at (bit, col) through its color layer until the
+// region stops changing. Only the columns the region has reached are
+// visited, so the cost follows the cluster's footprint, not the board size.
+BitBoard::Region BitBoard::floodFill(int bit, int col) {
+  Region r;
+  r.color = colorAt(bit, col);
+  r.lo = r.hi = col;
+  r.size = 0;
+  if (r.color < 0)
+    return r;
+
+  const uint64_t *mask = layer(r.color);
+  region[col] = 1ULL << bit;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int c = r.lo; c <= r.hi; c++) {
+      uint64_t cur = region[c];
+      uint64_t grown = cur;
+      if (c > r.lo)
+        grown |= region[c - 1];
+      if (c < r.hi)
+        grown |= region[c + 1];
+      grown &= mask[c];
+      // Vertical runs are filled completely before moving on
+      uint64_t prev;
+      do {
+        prev = grown;
+        grown = (grown | (grown << 1) | (grown >> 1)) & mask[c];
+      } while (grown != prev);
+      if (grown != cur) {
+        region[c] = grown;
+        changed = true;
+      }
+    }
+    if (r.lo > 0 && (region[r.lo] & mask[r.lo - 1])) {
+      r.lo--;
+      changed = true;
+    }
+    if (r.hi + 1 < activeCols && (region[r.hi] & mask[r.hi + 1])) {
+      r.hi++;
+      changed = true;
+    }
+  }
+
+  for (int c = r.lo; c <= r.hi; c++) {
+    r.size += popCount(region[c]);
+  }
+  return r;
+}
+
+void BitBoard::clearRegion(const Region &r) {
+  for (int c = r.lo; c <= r.hi; c++) {
+    region[c] = 0;
+  }
+}
+
+vector<pair<int, int>> BitBoard::getCluster(int row, int col) {
+  vector<pair<int, int>> cluster;
+  if (!isTileActive(row, col))
+    return cluster;
+
+  Region r = floodFill(bitOf(row), col);
+  cluster.reserve(r.size);
+  for (int c = r.lo; c <= r.hi; c++) {
+    for (uint64_t bits = region[c]; bits; bits &= bits - 1) {
+      cluster.push_back({rowOf(lowestBit(bits)), c});
+    }
+  }
+  clearRegion(r);
+  return cluster;
+}
+
+int BitBoard::getClusterSize(int row, int col) {
+  if (!isTileActive(row, col))
+    return 0;
+  Region r = floodFill(bitOf(row), col);
+  clearRegion(r);
+  return r.size;
+}
+
+int BitBoard::removeCluster(int row, int col, Undo *undo) {
+  if (!isTileActive(row, col))
+    return 0;
+
+  Region r = floodFill(bitOf(row), col);
+  if (r.size < 2) {
+    clearRegion(r);
+    return 0;
+  }
+
+  if (undo) {
+    undo->color = r.color;
+    undo->activeCols = activeCols;
+    undo->hash = hash;
+    undo->columns.clear();
+  }
+
+  uint64_t *removedLayer = layer(r.color);
+  bool emptied = false;
+  for (int c = r.lo; c <= r.hi; c++) {
+    uint64_t gone = region[c];
+    if (!gone)
+      continue;
+    region[c] = 0;
+
+    removedLayer[c] &= ~gone;
+    uint64_t keep = occupied[c] & ~gone;
+    if (undo) {
+      undo->columns.push_back({c, gone, keep});
+    }
+
+    hash ^= keysOf(gone, c, r.color);
+
+    // Gravity: squeeze every color layer down onto the surviving tiles.
+    // Tiles that stay put cancel out of the hash update.
+    for (int color = 0; color < numColors; color++) {
+      uint64_t &word = layer(color)[c];
+      if (word) {
+        uint64_t fallen = compactBits(word, keep);
+        hash ^= keysOf(word ^ fallen, c, color);
+        word = fallen;
+      }
+    }
+    occupied[c] = lowBits(popCount(keep));
+    if (!occupied[c])
+      emptied = true;
+  }
+
+  if (emptied)
+    collapseColumns(r.lo);
+
+  return r.size;
+}
+
+void BitBoard::unmakeRemoval(const Undo &undo) {
+  // Re-open the columns the removal emptied, shifting the rest back right.
+  // Working from the right, `read` catches up with `c` once every emptied
+  // column has been re-inserted.
+  int k = undo.columns.size() - 1;
+  int read = activeCols - 1;
+  for (int c = undo.activeCols - 1; c > read; c--) {
+    while (k >= 0 && undo.columns[k].col > c)
+      k--;
+    bool emptied = k >= 0 && undo.columns[k].col == c && !undo.columns[k].kept;
+    occupied[c] = emptied ? 0 : occupied[read];
+    for (int color = 0; color < numColors; color++) {
+      layer(color)[c] = emptied ? 0 : layer(color)[read];
+    }
+    if (!emptied)
+      read--;
+  }
+  activeCols = undo.activeCols;
+
+  // Lift the fallen tiles back up and put the removed ones back
+  for (const ColumnChange &change : undo.columns) {
+    int c = change.col;
+    for (int color = 0; color < numColors; color++) {
+      uint64_t &word = layer(color)[c];
+      if (word)
+        word = expandBits(word, change.kept);
+    }
+    layer(undo.color)[c] |= change.removed;
+    occupied[c] = change.kept | change.removed;
+  }
+  hash = undo.hash;
+}
+
+// Shifts non-empty columns left over empty ones, starting at `from`.
+void BitBoard::collapseColumns(int from) {
+  int write = from;
+  for (int c = from; c < activeCols; c++) {
+    if (!occupied[c])
+      continue;
+    if (c != write) {
+      occupied[write] = occupied[c];
+      for (int color = 0; color < numColors; color++) {
+        uint64_t word = layer(color)[c];
+        hash ^= keysOf(word, c, color) ^ keysOf(word, write, color);
+        layer(color)[write] = word;
+      }
+    }
+    write++;
+  }
+  for (int c = write; c < activeCols; c++) {
+    occupied[c] = 0;
+    for (int color = 0; color < numColors; color++) {
+      layer(color)[c] = 0;
+    }
+  }
+  activeCols = write;
+}
+
+// One word-wide flood fill per cluster. A union-find over vertical runs, the
+// single pass SameGame::labelClusters makes on the graph, measured 30-60%
+// slower here: on a five-color board most runs are one or two tiles, so the
+// per-run bookkeeping costs more than the fills it replaces.
+void BitBoard::collectClusters(vector<ClusterInfo> &out) {
+  for (int c = 0; c < activeCols; c++) {
+    unvisited[c] = occupied[c];
+  }
+
+  // Scanning columns left to right and bits bottom up, the first tile seen
+  // of each cluster is the lowest tile of its leftmost column.
+  for (int c = 0; c < activeCols; c++) {
+    while (unvisited[c]) {
+      int bit = lowestBit(unvisited[c]);
+      Region r = floodFill(bit, c);
+      uint64_t rowsUsed = 0;
+      int maxCol = c;
+      for (int cc = r.lo; cc <= r.hi; cc++) {
+        if (region[cc]) {
+          rowsUsed |= region[cc];
+          maxCol = cc;
+        }
+        unvisited[cc] &= ~region[cc];
+        region[cc] = 0;
+      }
+      if (r.size >= 2) {
+        ClusterInfo info;
+        info.size = r.size;
+        info.color = palette[r.color];
+        info.row = rowOf(bit);
+        info.col = c;
+        info.minRow = rowOf(63 - __builtin_clzll(rowsUsed));
+        info.maxRow = rowOf(lowestBit(rowsUsed));
+        info.minCol = c;
+        info.maxCol = maxCol;
+        out.push_back(info);
+      }
+    }
+  }
+}
+
+bool BitBoard::hasMovesLeft() const {
+  for (int color = 0; color < numColors; color++) {
+    const uint64_t *mask = layer(color);
+    for (int c = 0; c < activeCols; c++) {
+      uint64_t m = mask[c];
+      if (m & (m >> 1))
+        return true;
+      if (c + 1 < activeCols && (m & mask[c + 1]))
+        return true;
+    }
+  }
+  return false;
+}
+
+int BitBoard::countActiveTiles() const {
+  int count = 0;
+  for (int c = 0; c < activeCols; c++) {
+    count += popCount(occupied[c]);
+  }
+  return count;
+}
+
+int BitBoard::countColorTiles(char color) const {
+  for (int k = 0; k < numColors; k++) {
+    if (palette[k] != color)
+      continue;
+    int count = 0;
+    const uint64_t *mask = layer(k);
+    for (int c = 0; c < activeCols; c++) {
+      count += popCount(mask[c]);
+    }
+    return count;
+  }
+  return 0;
+}
+
+int BitBoard::countColorAdjacencies() const {
+  int adj = 0;
+  for (int c = 0; c < activeCols; c++) {
+    adj += columnAdjacencies(c);
+  }
+  return adj;
+}
+
+int BitBoard::countIsolatedTiles() const {
+  int isolated = 0;
+  for (int c = 0; c < activeCols; c++) {
+    isolated += columnIsolated(c);
+  }
+  return isolated;
+}
+
+int BitBoard::columnAdjacencies(int col) const {
+  if (col >= activeCols)
+    return 0;
+  int adj = 0;
+  for (int color = 0; color < numColors; color++) {
+    const uint64_t *mask = layer(color);
+    uint64_t m = mask[col];
+    adj += popCount(m & (m >> 1));
+    if (col + 1 < activeCols)
+      adj += popCount(m & mask[col + 1]);
+  }
+  return adj;
+}
+
+int BitBoard::columnIsolated(int col) const {
+  if (col >= activeCols)
+    return 0;
+  int isolated = 0;
+  for (int color = 0; color < numColors; color++) {
+    const uint64_t *mask = layer(color);
+    uint64_t m = mask[col];
+    uint64_t touching = (m << 1) | (m >> 1);
+    if (col > 0)
+      touching |= mask[col - 1];
+    if (col + 1 < activeCols)
+      touching |= mask[col + 1];
+    isolated += popCount(m & ~touching);
+  }
+  return isolated;
+}
@@ -0,0 +1,105 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include "ClusterInfo.h"
+
+using namespace std;
+
+// Bit-parallel board backend.
+//
+// Every column is one 64-bit word per color plus one occupancy word. Bit b of
+// a column word is the tile b rows above the bottom of the board, so:
+//   - vertical neighbours are a shift by one bit,
+//   - horizontal neighbours are the same bit in the adjacent column word,
+//   - gravity is a per-column bit compaction,
+//   - column collapse is moving whole words to the left.
+class BitBoard {
+private:
+    int rows;
+    int cols;
+    int numColors;
+    int activeCols;              // columns [activeCols, cols) are empty
+    uint64_t hash;               // Zobrist hash of the tiles
+
+    vector<char> palette;        // color index -> tile character
+    vector<uint64_t> colorBits;  // numColors * cols words, color-major
+    vector<uint64_t> occupied;   // one word per column
+
+    // Flood-fill output, one word per column. Always all-zero between calls
+    // except for the columns reported by the last floodFill.
+    vector<uint64_t> region;
+    vector<uint64_t> unvisited;
+
+    struct Region {
+        int color;
+        int lo, hi;  // column span touched in `region`
+        int size;
+    };
+
+    uint64_t* layer(int color) { return &colorBits[color * cols]; }
+    const uint64_t* layer(int color) const { return &colorBits[color * cols]; }
+    int bitOf(int row) const { return rows - 1 - row; }
+    int rowOf(int bit) const { return rows - 1 - bit; }
+    int colorAt(int bit, int col) const;
+    uint64_t keysOf(uint64_t bits, int col, int color) const;
+
+    Region floodFill(int bit, int col);
+    void clearRegion(const Region& r);
+    void collapseColumns(int from);
+
+public:
+    // What a removal changed, in the column numbering from before the
+    // collapse: enough to rebuild exactly the touched columns.
+    struct ColumnChange {
+        int col;
+        uint64_t removed;  // tiles taken out of this column
+        uint64_t kept;     // tiles that stayed (and fell)
+    };
+    struct Undo {
+        int color;
+        int activeCols;
+        uint64_t hash;
+        vector<ColumnChange> columns;
+    };
+
+    static const int MAX_ROWS = 63;
+    static bool supports(int rows, int cols) {
+        return rows > 0 && rows <= MAX_ROWS && cols > 0;
+    }
+
+    BitBoard() : rows(0), cols(0), numColors(0), activeCols(0), hash(0) {}
+    void load(const vector<vector<char>>& grid);
+
+    char getTile(int row, int col) const;
+    bool isTileActive(int row, int col) const;
+    uint64_t getHash() const { return hash; }
+
+    vector<pair<int, int>> getCluster(int row, int col);
+    int getClusterSize(int row, int col);
+    // Removes the cluster and applies gravity. Returns the number of tiles
+    // removed, or 0 when the cluster is smaller than two tiles. When `undo`
+    // is given it receives what unmakeRemoval needs to restore the board.
+    int removeCluster(int row, int col, Undo* undo = nullptr);
+    void unmakeRemoval(const Undo& undo);
+    // Appends every cluster of two or more tiles to `out`
+    void collectClusters(vector<ClusterInfo>& out);
+    bool hasMovesLeft() const;
+
+    // Whole-board feature counts used by the evaluation.
+    int countActiveTiles() const;
+    int countColorTiles(char color) const;
+    int countColorAdjacencies() const;
+    int countIsolatedTiles() const;
+    // One column's share of the counts above: same-color pairs inside the
+    // column and with the column to its right, and tiles with no same-color
+    // neighbor. Lets a caller update the totals for the columns a move
+    // changed.
+    int columnAdjacencies(int col) const;
+    int columnIsolated(int col) const;
+};
+
+#endif
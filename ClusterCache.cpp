@@ -0,0 +1,73 @@
+#include "ClusterCache.h"
+#include <algorithm>
+
+ClusterCache::ClusterCache(size_t megabytes)
+    : budgetBytes(megabytes * 1024 * 1024), slotCount(0), slotCapacity(0),
+      lookups(0), hits(0) {}
+
+ClusterCache::ClusterCache(const ClusterCache &other)
+    : budgetBytes(other.budgetBytes), slotCount(other.slotCount),
+      slotCapacity(other.slotCapacity), lookups(0), hits(0) {}
+
+ClusterCache &ClusterCache::operator=(const ClusterCache &other) {
+  budgetBytes = other.budgetBytes;
+  slotCount = other.slotCount;
+  slotCapacity = other.slotCapacity;
+  entries.clear();
+  pool.reset();
+  lookups = 0;
+  hits = 0;
+  return *this;
+}
+
+void ClusterCache::configure(int cells) {
+  // A cluster has at least two tiles, but most boards have far fewer than
+  // cells / 2 clusters; room for a quarter caches nearly every list
+  slotCapacity = max(1, cells / 4);
+  size_t perSlot = sizeof(Entry) + slotCapacity * sizeof(ClusterInfo);
+  size_t count = perSlot <= budgetBytes ? 1 : 0;
+  while (count > 0 && count * 2 * perSlot <= budgetBytes) {
+    count *= 2;
+  }
+  slotCount = count;
+  entries.clear();
+  pool.reset();
+}
+
+void ClusterCache::clear() {
+  for (Entry &entry : entries) {
+    entry.count = -1;
+  }
+}
+
+bool ClusterCache::find(uint64_t key, ClusterList &out) {
+  lookups++;
+  if (entries.empty())
+    return false;
+  size_t slot = key & (slotCount - 1);
+  const Entry &entry = entries[slot];
+  if (entry.count < 0 || entry.key != key)
+    return false;
+  hits++;
+  const ClusterInfo *first = &pool[slot * slotCapacity];
+  out = ClusterList(first, first + entry.count);
+  return true;
+}
+
+ClusterList ClusterCache::store(uint64_t key,
+                                const vector<ClusterInfo> &clusters) {
+  if (slotCount == 0 || clusters.size() > slotCapacity)
+    return ClusterList(clusters);
+  if (entries.empty()) {
+    entries.resize(slotCount);
+    pool.reset(new ClusterInfo[slotCount * slotCapacity]);
+    clear();
+  }
+  size_t slot = key & (slotCount - 1);
+  Entry &entry = entries[slot];
+  entry.key = key;
+  entry.count = clusters.size();
+  ClusterInfo *first = &pool[slot * slotCapacity];
+  copy(clusters.begin(), clusters.end(), first);
+  return ClusterList(first, first + entry.count);
+}
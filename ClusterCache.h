@@ -0,0 +1,78 @@
+#ifndef CLUSTERCACHE_H
+#define CLUSTERCACHE_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "ClusterInfo.h"
+
+using namespace std;
+
+// A read-only run of clusters: a cached move list, or a whole vector.
+struct ClusterList {
+    const ClusterInfo* first = nullptr;
+    const ClusterInfo* last = nullptr;
+
+    ClusterList() = default;
+    ClusterList(const ClusterInfo* begin, const ClusterInfo* end) : first(begin), last(end) {}
+    ClusterList(const vector<ClusterInfo>& clusters)
+        : first(clusters.data()), last(clusters.data() + clusters.size()) {}
+
+    const ClusterInfo* begin() const { return first; }
+    const ClusterInfo* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const ClusterInfo& operator[](size_t i) const { return first[i]; }
+};
+
+// Direct-mapped cache of generated move lists, keyed by the Zobrist hash of
+// the tiles alone: the clusters of a board don't depend on who moves next.
+//
+// Removing independent clusters in either order reaches the same board, so
+// the search meets many positions more than once, and each visit would
+// otherwise label the whole board again. Every slot has room for a fixed
+// number of clusters in one pool, allocated on the first store, so a cache
+// in use never allocates; a longer list is not cached.
+//
+// Not thread-safe. Copies start empty, which gives every search thread's
+// copy of the game a cache of its own.
+class ClusterCache {
+private:
+    struct Entry {
+        uint64_t key;
+        int count;  // clusters in the slot's part of the pool, -1 if empty
+    };
+
+    vector<Entry> entries;
+    // slotCapacity clusters per slot, left uninitialized: only a slot's
+    // first `count` clusters are ever read
+    unique_ptr<ClusterInfo[]> pool;
+    size_t budgetBytes;
+    size_t slotCount;     // chosen by configure(), allocated on first store;
+    size_t slotCapacity;  // 0 slots when one list would exceed the budget
+    long long lookups;
+    long long hits;
+
+public:
+    static const size_t DEFAULT_MB = 4;
+
+    explicit ClusterCache(size_t megabytes = DEFAULT_MB);
+    ClusterCache(const ClusterCache& other);
+    ClusterCache& operator=(const ClusterCache& other);
+
+    // Sizes the cache for boards of `cells` tiles and empties it
+    void configure(int cells);
+    void clear();
+
+    // Sets `out` to the list stored for `key`, valid until the next store()
+    bool find(uint64_t key, ClusterList& out);
+    // The stored copy of `clusters`, or `clusters` itself when it doesn't fit
+    ClusterList store(uint64_t key, const vector<ClusterInfo>& clusters);
+
+    size_t capacity() const { return slotCount; }
+    long long getLookups() const { return lookups; }
+    long long getHits() const { return hits; }
+};
+
+#endif
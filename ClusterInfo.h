@@ -0,0 +1,15 @@
+#ifndef CLUSTERINFO_H
+#define CLUSTERINFO_H
+
+// One removable cluster, as produced by a single labelling pass over the
+// board. (row, col) is the representative tile: the lowest tile of the
+// cluster's leftmost column. Any tile of the cluster selects the same move.
+struct ClusterInfo {
+    int size;
+    char color;
+    int row, col;
+    int minRow, maxRow; // bounding box
+    int minCol, maxCol;
+};
+
+#endif
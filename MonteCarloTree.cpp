@@ -0,0 +1,216 @@
+#include "MonteCarloTree.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const uint64_t RNG_SEED = 0x2545F4914F6CDD1DULL;
+
+} // namespace
+
+MonteCarloTree::MonteCarloTree()
+    : maxNodes(0), rng(RNG_SEED), deepest(0), playouts(0) {}
+
+void MonteCarloTree::clear() {
+  nodes.clear();
+  rng = RNG_SEED;
+  deepest = 0;
+  playouts = 0;
+}
+
+uint64_t MonteCarloTree::nextRandom() {
+  // xorshift64*
+  rng ^= rng >> 12;
+  rng ^= rng << 25;
+  rng ^= rng >> 27;
+  return rng * 0x2545F4914F6CDD1DULL;
+}
+
+// Makes the node for `hash` the root if it is the current root, a child or a
+// grandchild of it. Returns false if the tree has nothing for this position.
+bool MonteCarloTree::reroot(uint64_t hash) {
+  if (nodes.empty())
+    return false;
+  if (nodes[0].hash == hash)
+    return true;
+
+  const Node &root = nodes[0];
+  for (int c = root.firstChild; c >= 0 && c < root.firstChild + root.childCount;
+       c++) {
+    if (nodes[c].hash == hash) {
+      keepSubtree(c);
+      return true;
+    }
+    const Node &child = nodes[c];
+    for (int g = child.firstChild;
+         g >= 0 && g < child.firstChild + child.childCount; g++) {
+      if (nodes[g].hash == hash) {
+        keepSubtree(g);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Copies the subtree under `newRoot` to the front of the pool, breadth
+// first, so each child block stays contiguous.
+void MonteCarloTree::keepSubtree(int newRoot) {
+  vector<Node> kept;
+  kept.reserve(nodes.capacity());
+  kept.push_back(nodes[newRoot]);
+  kept[0].move = -1;
+  for (size_t i = 0; i < kept.size(); i++) {
+    int oldFirst = kept[i].firstChild;
+    if (oldFirst < 0)
+      continue;
+    kept[i].firstChild = kept.size();
+    for (int c = 0; c < kept[i].childCount; c++) {
+      kept.push_back(nodes[oldFirst + c]);
+    }
+  }
+  nodes.swap(kept);
+}
+
+// Adds a child for every cluster, largest first, so the first unvisited
+// children tried are the likeliest good moves. Fails when the tree is full,
+// except at the root, which always needs its moves.
+bool MonteCarloTree::expand(SameGame &game, int node) {
+  vector<ClusterInfo> clusters = game.getClusterInfo();
+  size_t needed = nodes.size() + clusters.size();
+  if (node != 0 && needed > maxNodes)
+    return false;
+  if (needed > nodes.capacity()) {
+    nodes.reserve(max(needed, min(maxNodes, nodes.capacity() * 2)));
+  }
+
+  stable_sort(clusters.begin(), clusters.end(),
+              [](const ClusterInfo &a, const ClusterInfo &b) {
+                return a.size > b.size;
+              });
+  nodes[node].firstChild = nodes.size();
+  nodes[node].childCount = clusters.size();
+  int cols = game.getCols();
+  for (const ClusterInfo &cluster : clusters) {
+    nodes.push_back({0, 0.0, cluster.row * cols + cluster.col, -1, 0, 0});
+  }
+  return true;
+}
+
+// UCB1 over the children of an expanded node; unvisited children first
+int MonteCarloTree::select(int node) const {
+  const Node &parent = nodes[node];
+  double logVisits = log((double)parent.visits + 1);
+  int best = parent.firstChild;
+  double bestScore = -1;
+  for (int c = parent.firstChild; c < parent.firstChild + parent.childCount;
+       c++) {
+    const Node &child = nodes[c];
+    if (child.visits == 0)
+      return c;
+    double score = child.reward / child.visits +
+                   EXPLORATION * sqrt(logVisits / child.visits);
+    if (score > bestScore) {
+      bestScore = score;
+      best = c;
+    }
+  }
+  return best;
+}
+
+void MonteCarloTree::playout(SameGame &game) {
+  int cols = game.getCols();
+  int plies = 0;
+  auto play = [&](int move) {
+    if (plies == (int)undoStack.size())
+      undoStack.emplace_back();
+    game.makeMove(move / cols, move % cols, undoStack[plies++]);
+  };
+
+  // Selection and expansion
+  path.clear();
+  path.push_back({0, false});
+  int node = 0;
+  while (true) {
+    if (nodes[node].firstChild < 0) {
+      if (node != 0 && nodes[node].visits == 0)
+        break; // first visit: roll out from here
+      if (!expand(game, node))
+        break; // tree is full
+    }
+    if (nodes[node].childCount == 0)
+      break; // game over
+
+    int child = select(node);
+    bool computerMoved = !game.getUserTurn();
+    play(nodes[child].move);
+    if (nodes[child].hash == 0)
+      nodes[child].hash = game.getHash();
+    path.push_back({child, computerMoved});
+    node = child;
+  }
+  deepest = max(deepest, plies);
+
+  // Random rollout to the end of the game
+  vector<ClusterInfo> clusters = game.getClusterInfo();
+  while (!clusters.empty()) {
+    const ClusterInfo &pick = clusters[nextRandom() % clusters.size()];
+    play(pick.row * cols + pick.col);
+    clusters = game.getClusterInfo();
+  }
+
+  double margin = game.getComputerScore() - game.getUserScore();
+  double computerReward = 0.5 + 0.5 * tanh(margin / 20.0);
+
+  while (plies > 0) {
+    game.unmakeMove(undoStack[--plies]);
+  }
+
+  for (const auto &[visited, computerMoved] : path) {
+    nodes[visited].visits++;
+    nodes[visited].reward += computerMoved ? computerReward : 1 - computerReward;
+  }
+}
+
+pair<int, int> MonteCarloTree::search(SameGame &game,
+                                      const SearchLimits &limits,
+                                      const atomic<bool> *stop) {
+  maxNodes = max<size_t>(1, (size_t)limits.treeMB * 1024 * 1024 / sizeof(Node));
+
+  uint64_t hash = game.getHash();
+  if (!reroot(hash)) {
+    nodes.clear();
+    nodes.push_back({hash, 0.0, -1, -1, 0, 0});
+  }
+
+  auto deadline =
+      chrono::steady_clock::now() + chrono::milliseconds(limits.timeMs);
+  deepest = 0;
+  playouts = 0;
+  while (!(stop && stop->load(memory_order_relaxed))) {
+    if (limits.maxNodes > 0 && playouts >= limits.maxNodes)
+      break;
+    // A playout costs far more than reading the clock
+    if (limits.timeMs > 0 && chrono::steady_clock::now() >= deadline)
+      break;
+    playout(game);
+    playouts++;
+  }
+
+  if (nodes[0].firstChild < 0)
+    expand(game, 0);
+
+  const Node &root = nodes[0];
+  int best = -1;
+  for (int c = root.firstChild; c < root.firstChild + root.childCount; c++) {
+    if (best < 0 || nodes[c].visits > nodes[best].visits) {
+      best = c;
+    }
+  }
+  if (best < 0)
+    return {-1, -1};
+
+  int cols = game.getCols();
+  return {nodes[best].move / cols, nodes[best].move % cols};
+}
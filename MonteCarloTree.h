@@ -0,0 +1,68 @@
+#ifndef MONTECARLOTREE_H
+#define MONTECARLOTREE_H
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "SameGame.h"
+
+using namespace std;
+
+// UCT search tree for SearchEngine::MonteCarlo.
+//
+// Each playout walks down the tree by UCB1, adds the children of the first
+// node it visits twice, finishes the game with random moves and credits the
+// result to every node on the way. The result is scored for the computer as
+// 0.5 + 0.5 * tanh(margin / 20), so winning matters most but margins count.
+//
+// The tree survives between searches: a new search that starts one or two
+// plies below the old root (the move played and the reply to it) keeps that
+// subtree. Nodes live in one vector, children stored contiguously, and the
+// tree stops growing at the memory cap while playouts continue.
+class MonteCarloTree {
+private:
+    struct Node {
+        uint64_t hash;     // position after `move`, 0 until first visited
+        double reward;     // summed over visits, for the player who made `move`
+        int move;          // row * cols + col of the cluster, -1 at the root
+        int firstChild;    // -1 until expanded
+        int childCount;
+        int visits;
+    };
+
+    vector<Node> nodes;            // nodes[0] is the root
+    size_t maxNodes;
+    uint64_t rng;
+    int deepest;                   // plies below the root reached by selection
+    long long playouts;
+
+    // Playout scratch, reused across playouts
+    vector<pair<int, bool>> path;  // node, made by the computer
+    vector<MoveUndo> undoStack;
+
+    static constexpr double EXPLORATION = 0.7;
+
+    bool reroot(uint64_t hash);
+    void keepSubtree(int newRoot);
+    bool expand(SameGame& game, int node);
+    int select(int node) const;
+    void playout(SameGame& game);
+    uint64_t nextRandom();
+
+public:
+    MonteCarloTree();
+
+    // Searches the position in `game`, which is restored before returning,
+    // and returns the most visited move. limits.maxNodes counts playouts.
+    pair<int, int> search(SameGame& game, const SearchLimits& limits,
+                          const atomic<bool>* stop);
+    void clear();
+
+    size_t size() const { return nodes.size(); }
+    int lastDepth() const { return deepest; }
+    long long lastPlayouts() const { return playouts; }
+};
+
+#endif
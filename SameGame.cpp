@@ -1,163 +1,337 @@
 #include "SameGame.h"
+#include "MonteCarloTree.h"
+#include "Zobrist.h"
 #include <algorithm>
 #include <climits>
 #include <cmath>
+#include <thread>
+#ifdef SAMEGAME_DEBUG_HASH
+#include <cassert>
+#endif
 
-SameGame::SameGame(const vector<vector<char>> &initialGrid) {
-  reset(initialGrid);
+namespace {
+
+// Up, right, down, left. Adjacency is implied by grid position, so nothing
+// has to be rebuilt when tiles fall or columns shift.
+const int DIR_ROW[4] = {-1, 0, 1, 0};
+const int DIR_COL[4] = {0, 1, 0, -1};
+
+const char EMPTY = '\0'; // graph backend: a cell with no tile
+
+// Search values are clamped to this so that they never overflow an int. A
+// clamped value only bounds the true one: boards whose scores run past the
+// limit all compare equal, and the transposition table doesn't store them.
+const long long VALUE_LIMIT = 1000000000;
+
+int clampValue(long long value) {
+  return (int)max(-VALUE_LIMIT, min(VALUE_LIMIT, value));
 }
 
-void SameGame::buildGraph(const vector<vector<char>> &initialGrid) {
-  nodes.clear();
+// Whether a search value, and the same value relative to the score
+// difference banked so far, are both exact and fit a table entry
+bool storableValue(long long value, long long scoreBase) {
+  return value > -VALUE_LIMIT && value < VALUE_LIMIT &&
+         value - scoreBase > -VALUE_LIMIT && value - scoreBase < VALUE_LIMIT;
+}
 
+// Most memory reserveSearchScratch() gives the per-ply buffers up front
+const size_t SCRATCH_RESERVE_BYTES = 32 << 20;
+
+// Wider than any endgame solver value, which is at most the points left on a
+// small board
+const int SOLVE_LIMIT = 1 << 30;
+
+// Move ordering weights, on the scale of getSmartMoveHeuristic()
+const int KILLER_BONUS = 2000;
+const int HISTORY_WEIGHT = 1;
+const int HISTORY_MAX = 1000;
+
+} // namespace
+
+SameGame::SameGame(const vector<vector<char>> &initialGrid,
+                   BoardBackend backend)
+    : requestedBackend(backend), solveMaxPly(0), solvedRootMove(-1),
+      lastSolved(false), provenLead(0), labelsHash(0),
+      transTable(make_shared<TranspositionTable>()),
+      searchTree(make_shared<MonteCarloTree>()), searchNodes(0),
+      searchAborted(false), horizonReached(false), lastSearchDepth(0),
+      rootDepth(0), stopSignal(nullptr), stats(nullptr) {
+  history.fill(0);
+  reset(initialGrid);
+}
+
+void SameGame::loadTiles(const vector<vector<char>> &initialGrid) {
   rows = initialGrid.size();
   cols = rows > 0 ? initialGrid[0].size() : 0;
 
-  nodeGrid.assign(rows, vector<int>(cols, -1));
-
-  int index = 0;
+  tiles.assign(rows * cols, EMPTY);
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < cols; j++) {
-      nodes.push_back(Node(i, j, initialGrid[i][j]));
-      nodeGrid[i][j] = index;
-      index++;
+      tiles[cellOf(i, j)] = initialGrid[i][j];
     }
   }
 
-  updateNeighbors();
+  colHeight.assign(cols, rows);
+  activeCols = rows > 0 ? cols : 0;
+  fillVisited.assign((rows * cols + 63) / 64, 0);
 }
 
-void SameGame::updateNeighbors() {
-  for (auto &node : nodes) {
-    node.neighbors.clear();
+char SameGame::tileAt(int row, int col) const {
+  if (row >= 0 && row < rows && col >= 0 && col < cols) {
+    return tiles[cellOf(row, col)];
   }
+  return EMPTY;
+}
 
-  vector<vector<int>> directions = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
-
-  for (auto &node : nodes) {
-    if (!node.active)
-      continue;
+void SameGame::reset(const vector<vector<char>> &initialGrid) {
+  int gridRows = initialGrid.size();
+  int gridCols = gridRows > 0 ? initialGrid[0].size() : 0;
+
+  // The graph backend is the faster one at every size bench measures; the
+  // bitboard is used only on request, and only when its columns fit a word
+  backend = requestedBackend;
+  if (backend == BoardBackend::Auto ||
+      (backend == BoardBackend::BitBoard &&
+       !BitBoard::supports(gridRows, gridCols))) {
+    backend = BoardBackend::Graph;
+  }
 
-    int row = node.row;
-    int col = node.col;
+  if (backend == BoardBackend::BitBoard) {
+    tiles.clear();
+    colHeight.clear();
+    rows = gridRows;
+    cols = gridCols;
+    bits.load(initialGrid);
+  } else {
+    bits = BitBoard();
+    loadTiles(initialGrid);
+    boardHash = computeBoardHash();
+  }
+  initEvalTerms();
+  clusterCache.configure(rows * cols);
+  clockInterval = rows * cols > 4096 ? 1 : 16;
+  score = 0;
+  moves = 0;
+  isUserTurn = true;
+  userScore = 0;
+  computerScore = 0;
+  // Copies made before the reset keep the old table
+  transTable =
+      make_shared<TranspositionTable>(transTable->budgetMegabytes());
+  searchTree = make_shared<MonteCarloTree>();
+  solvedTable = make_shared<vector<SolvedPosition>>();
+#ifdef SAMEGAME_DEBUG_HASH
+  hashCollisions = 0;
+#endif
+}
 
-    for (const auto &dir : directions) {
-      int newRow = row + dir[0];
-      int newCol = col + dir[1];
 
-      if (newRow >= 0 && newRow < rows && newCol >= 0 && newCol < cols) {
-        int neighborIdx = getNodeIndex(newRow, newCol);
-        if (neighborIdx != -1 && nodes[neighborIdx].active) {
-          node.neighbors.push_back(neighborIdx);
-        }
+uint64_t SameGame::computeBoardHash() const {
+  uint64_t hash = 0;
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      if (isTileActive(i, j)) {
+        hash ^= zobrist::tileKey(i, j, getTile(i, j));
       }
     }
   }
+  return hash;
 }
 
-int SameGame::getNodeIndex(int row, int col) const {
-  if (row >= 0 && row < rows && col >= 0 && col < cols) {
-    return nodeGrid[row][col];
-  }
-  return -1;
+uint64_t SameGame::tileHash() const {
+  return backend == BoardBackend::BitBoard ? bits.getHash() : boardHash;
 }
 
-void SameGame::reset(const vector<vector<char>> &initialGrid) {
-  buildGraph(initialGrid);
-  score = 0;
-  moves = 0;
-  isUserTurn = true;
-  userScore = 0;
-  computerScore = 0;
-  transTable.clear();
+uint64_t SameGame::getHash() const {
+  uint64_t hash = tileHash();
+  return isUserTurn ? hash : hash ^ zobrist::SIDE_KEY;
 }
 
 char SameGame::getTile(int row, int col) const {
-  int nodeIdx = getNodeIndex(row, col);
-  if (nodeIdx != -1) {
-    return nodes[nodeIdx].color;
-  }
-  return '\0';
+  if (backend == BoardBackend::BitBoard)
+    return bits.getTile(row, col);
+  return tileAt(row, col);
 }
 
 bool SameGame::isTileActive(int row, int col) const {
-  int nodeIdx = getNodeIndex(row, col);
-  if (nodeIdx != -1) {
-    return nodes[nodeIdx].active;
-  }
-  return false;
+  if (backend == BoardBackend::BitBoard)
+    return bits.isTileActive(row, col);
+  return tileAt(row, col) != EMPTY;
 }
 
 vector<pair<int, int>> SameGame::detectClusterBFS(int startRow, int startCol) {
-  vector<pair<int, int>> cluster;
+  if (backend == BoardBackend::BitBoard)
+    return bits.getCluster(startRow, startCol);
 
-  int startNodeIdx = getNodeIndex(startRow, startCol);
-  if (startNodeIdx == -1 || !nodes[startNodeIdx].active) {
-    return cluster;
+  floodFill(startRow, startCol);
+  vector<pair<int, int>> cluster;
+  cluster.reserve(fillCells.size());
+  for (int cell : fillCells) {
+    cluster.push_back({rows - 1 - cell % rows, cell / rows});
   }
+  return cluster;
+}
 
-  char color = nodes[startNodeIdx].color;
-  unordered_set<int> visited;
-  queue<int> q;
-
-  q.push(startNodeIdx);
-  visited.insert(startNodeIdx);
-  cluster.push_back({nodes[startNodeIdx].row, nodes[startNodeIdx].col});
-
-  vector<vector<int>> directions = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
+// Breadth-first, with fillCells doubling as the queue
+void SameGame::floodFill(int row, int col) {
+  fillCells.clear();
+  char color = tileAt(row, col);
+  if (color == EMPTY)
+    return;
+
+  auto reach = [&](int cell) {
+    uint64_t bit = 1ULL << (cell & 63);
+    if (tiles[cell] != color || (fillVisited[cell >> 6] & bit))
+      return;
+    fillVisited[cell >> 6] |= bit;
+    fillCells.push_back(cell);
+  };
+
+  reach(cellOf(row, col));
+  for (size_t next = 0; next < fillCells.size(); next++) {
+    int cell = fillCells[next];
+    int h = cell % rows;
+    // Up, right, down, left
+    if (h + 1 < rows)
+      reach(cell + 1);
+    if (cell + rows < rows * cols)
+      reach(cell + rows);
+    if (h > 0)
+      reach(cell - 1);
+    if (cell >= rows)
+      reach(cell - rows);
+  }
 
-  while (!q.empty()) {
-    int currentIdx = q.front();
-    q.pop();
+  for (int cell : fillCells) {
+    fillVisited[cell >> 6] &= ~(1ULL << (cell & 63));
+  }
+}
 
-    Node &currentNode = nodes[currentIdx];
-    int x = currentNode.row;
-    int y = currentNode.col;
+vector<pair<int, int>> SameGame::getCluster(int row, int col) {
+  return detectClusterBFS(row, col);
+}
 
-    for (const auto &dir : directions) {
-      int newX = x + dir[0];
-      int newY = y + dir[1];
+int SameGame::getClusterSize(int row, int col) {
+  if (backend == BoardBackend::BitBoard)
+    return bits.getClusterSize(row, col);
+  floodFill(row, col);
+  return fillCells.size();
+}
 
-      if (newX >= 0 && newX < rows && newY >= 0 && newY < cols) {
-        int neighborIdx = nodeGrid[newX][newY];
-        if (neighborIdx != -1 && visited.find(neighborIdx) == visited.end() &&
-            nodes[neighborIdx].active && nodes[neighborIdx].color == color) {
+const vector<int> &SameGame::getClusterLabels() {
+  int n = rows * cols;
+  uint64_t hash = tileHash();
+  if ((int)cellLabels.size() == n && labelsHash == hash)
+    return cellLabels;
+  labelsHash = hash;
+
+  // The union-find of labelClusters() over the graph's tiles; the bitboard
+  // first copies its tiles into the same column-major layout
+  const char *grid = tiles.data();
+  int linkedCols = activeCols;
+  if (backend == BoardBackend::BitBoard) {
+    labelGrid.resize(n);
+    for (int c = 0; c < cols; c++) {
+      for (int h = 0; h < rows; h++) {
+        int r = rows - 1 - h;
+        labelGrid[c * rows + h] = bits.isTileActive(r, c) ? bits.getTile(r, c)
+                                                          : EMPTY;
+      }
+    }
+    grid = labelGrid.data();
+    linkedCols = cols;
+  }
+  linkClusters(grid, linkedCols);
+
+  // Labels in scan order into ccSlot; a root comes first in its cluster, so
+  // it has its label before any other tile asks for it
+  labelSizes.clear();
+  for (int cell = 0; cell < rows * linkedCols; cell++) {
+    if (ccParent[cell] == -1) {
+      ccSlot[cell] = -1;
+      continue;
+    }
+    int root = findRoot(cell);
+    if (root == cell) {
+      ccSlot[cell] = labelSizes.size();
+      labelSizes.push_back(0);
+    }
+    ccSlot[cell] = ccSlot[root];
+    labelSizes[ccSlot[cell]]++;
+  }
 
-          visited.insert(neighborIdx);
-          q.push(neighborIdx);
-          cluster.push_back({nodes[neighborIdx].row, nodes[neighborIdx].col});
+  // Then transposed to row-major in blocks, which keeps both sides in cache
+  const int BLOCK = 64;
+  cellLabels.assign(n, -1);
+  for (int c0 = 0; c0 < linkedCols; c0 += BLOCK) {
+    int c1 = min(c0 + BLOCK, linkedCols);
+    for (int h0 = 0; h0 < rows; h0 += BLOCK) {
+      int h1 = min(h0 + BLOCK, rows);
+      for (int h = h0; h < h1; h++) {
+        int *row = &cellLabels[(rows - 1 - h) * cols];
+        for (int c = c0; c < c1; c++) {
+          row[c] = ccSlot[c * rows + h];
         }
       }
     }
   }
-
-  return cluster;
+  return cellLabels;
 }
 
-vector<pair<int, int>> SameGame::getCluster(int row, int col) {
-  return detectClusterBFS(row, col);
+bool SameGame::removeCluster(int row, int col) {
+  // The undo record also carries the changed columns the evaluation needs
+  MoveUndo undo;
+  return makeMove(row, col, undo);
 }
 
-int SameGame::getClusterSize(int row, int col) {
-  return detectClusterBFS(row, col).size();
-}
+bool SameGame::makeMove(int row, int col, MoveUndo &undo) {
+  int clusterSize;
+  char color = getTile(row, col);
 
-bool SameGame::removeCluster(int row, int col) {
-  vector<pair<int, int>> cluster = detectClusterBFS(row, col);
+  if (backend == BoardBackend::BitBoard) {
+    // The bitboard applies its own gravity as part of the removal
+    clusterSize = bits.removeCluster(row, col, &undo.bits);
+    if (clusterSize < 2) {
+      return false;
+    }
+  } else {
+    floodFill(row, col);
 
-  if (cluster.size() < 2) {
-    return false;
-  }
+    if (fillCells.size() < 2) {
+      return false;
+    }
 
-  for (const auto &tile : cluster) {
-    int nodeIdx = getNodeIndex(tile.first, tile.second);
-    if (nodeIdx != -1) {
-      nodes[nodeIdx].active = false;
+    undo.boardHash = boardHash;
+
+    int firstCol = cols, lastCol = -1, baseHeight = rows;
+    for (int cell : fillCells) {
+      firstCol = min(firstCol, cell / rows);
+      lastCol = max(lastCol, cell / rows);
+      baseHeight = min(baseHeight, cell % rows);
+    }
+    int bottomRow = rows - 1 - baseHeight;
+    // Nothing below the row under the cluster moves or changes neighbours
+    recordEvalRows(firstCol, lastCol, min(rows - 1, bottomRow + 1), undo);
+
+    undo.baseHeight = baseHeight;
+    undo.columnTiles.clear();
+    for (int j = firstCol; j <= lastCol; j++) {
+      auto column = tiles.begin() + j * rows;
+      undo.columnTiles.insert(undo.columnTiles.end(), column + baseHeight,
+                              column + colHeight[j]);
     }
+
+    for (int cell : fillCells) {
+      tiles[cell] = EMPTY;
+      boardHash ^= zobrist::tileKey(rows - 1 - cell % rows, cell / rows, color);
+    }
+
+    clusterSize = fillCells.size();
+    applyGravity(firstCol, lastCol, bottomRow, undo);
   }
 
-  int clusterSize = cluster.size();
-  int points = (clusterSize - 2) * (clusterSize - 2);
+  long long points = (long long)(clusterSize - 2) * (clusterSize - 2);
+  undo.points = points;
   score += points;
 
   if (isUserTurn) {
@@ -170,67 +344,171 @@ bool SameGame::removeCluster(int row, int col) {
 
   switchTurn();
 
-  applyGravity();
+  if (backend == BoardBackend::BitBoard) {
+    const BitBoard::Undo &change = undo.bits;
+    int emptied = 0;
+    for (const auto &column : change.columns) {
+      if (!column.kept)
+        emptied++;
+    }
+    undo.firstChangedCol = change.columns.front().col;
+    undo.lastChangedCol =
+        emptied ? change.activeCols - 1 : change.columns.back().col;
+    undo.collapsedCols = emptied;
+  }
+
+  undo.color = color;
+  undo.removed = clusterSize;
+  updateEvalTerms(undo);
+
+#ifdef SAMEGAME_DEBUG_HASH
+  assert(getHash() == (computeBoardHash() ^
+                       (isUserTurn ? 0 : zobrist::SIDE_KEY)));
+  verifyEvalTerms();
+#endif
 
   return true;
 }
 
-void SameGame::applyGravity() {
-  for (int j = 0; j < cols; j++) {
-    int pos = rows - 1;
-    for (int i = rows - 1; i >= 0; i--) {
-      int nodeIdx = nodeGrid[i][j];
-      if (nodeIdx != -1 && nodes[nodeIdx].active) {
-        if (i != pos) {
-          nodeGrid[i][j] = -1;
-          nodeGrid[pos][j] = nodeIdx;
+void SameGame::unmakeMove(const MoveUndo &undo) {
+  switchTurn();
+  moves--;
+  score -= undo.points;
+  if (isUserTurn) {
+    userScore -= undo.points;
+  } else {
+    computerScore -= undo.points;
+  }
+  restoreEvalTerms(undo);
+
+  if (backend == BoardBackend::BitBoard) {
+    bits.unmakeRemoval(undo.bits);
+#ifdef SAMEGAME_DEBUG_HASH
+    verifyEvalTerms();
+#endif
+    return;
+  }
 
-          nodes[nodeIdx].row = pos;
-          nodes[nodeIdx].col = j;
-        }
-        pos--;
+  // Move the columns that shifted left back over the emptied ones, right to
+  // left so no column is overwritten before it has moved
+  int firstCol = undo.firstChangedCol;
+  if (!undo.emptiedCols.empty()) {
+    int from = activeCols - 1;
+    int emptied = undo.emptiedCols.size() - 1;
+    for (int j = undo.activeColsBefore - 1; j >= firstCol; j--) {
+      if (emptied >= 0 && undo.emptiedCols[emptied] == j) {
+        emptied--;
+        continue;
       }
-    }
-    // Clear remaining rows above
-    for (int i = pos; i >= 0; i--) {
-      nodeGrid[i][j] = -1;
+      if (from != j) {
+        copy(tiles.begin() + from * rows, tiles.begin() + (from + 1) * rows,
+             tiles.begin() + j * rows);
+        fill(tiles.begin() + from * rows, tiles.begin() + (from + 1) * rows,
+             EMPTY);
+      }
+      from--;
     }
   }
 
-  int col = 0;
-  for (int j = 0; j < cols; j++) {
-    bool hasTiles = false;
-    for (int i = 0; i < rows; i++) {
-      int nodeIdx = nodeGrid[i][j];
-      if (nodeIdx != -1 && nodes[nodeIdx].active) {
-        hasTiles = true;
-        break;
+  // The saved runs cover the cluster's columns, from firstChangedCol on
+  copy(undo.colHeights.begin(), undo.colHeights.end(),
+       colHeight.begin() + firstCol);
+  auto saved = undo.columnTiles.begin();
+  for (int j = firstCol; saved != undo.columnTiles.end(); j++) {
+    int length = colHeight[j] - undo.baseHeight;
+    copy(saved, saved + length, tiles.begin() + j * rows + undo.baseHeight);
+    saved += length;
+  }
+  activeCols = undo.activeColsBefore;
+  boardHash = undo.boardHash;
+#ifdef SAMEGAME_DEBUG_HASH
+  verifyEvalTerms();
+#endif
+}
+
+// Settles the columns [firstCol, lastCol] the removed cluster touched, then
+// closes any column that became empty by shifting the columns to its right.
+// Non-empty columns always form the prefix [0, activeCols), so untouched
+// columns left of the cluster are never visited, and tiles below bottomRow,
+// the cluster's lowest row, never move.
+void SameGame::applyGravity(int firstCol, int lastCol, int bottomRow,
+                            MoveUndo &undo) {
+  undo.activeColsBefore = activeCols;
+  undo.colHeights.assign(colHeight.begin() + firstCol,
+                         colHeight.begin() + lastCol + 1);
+  undo.emptiedCols.clear();
+
+  // A column settles by compacting its run, bottom up
+  int base = rows - 1 - bottomRow;
+  bool emptied = false;
+  for (int j = firstCol; j <= lastCol; j++) {
+    char *column = &tiles[j * rows];
+    int pos = base;
+    for (int h = base; h < colHeight[j]; h++) {
+      char color = column[h];
+      if (color == EMPTY)
+        continue;
+      if (h != pos) {
+        column[pos] = color;
+        column[h] = EMPTY;
+        boardHash ^= zobrist::tileKey(rows - 1 - h, j, color) ^
+                     zobrist::tileKey(rows - 1 - pos, j, color);
       }
+      pos++;
     }
+    colHeight[j] = pos;
+    if (pos == 0)
+      emptied = true;
+  }
 
-    if (hasTiles) {
+  int collapsed = 0;
+  if (emptied) {
+    undo.colHeights.insert(undo.colHeights.end(),
+                           colHeight.begin() + lastCol + 1,
+                           colHeight.begin() + activeCols);
+
+    int col = firstCol;
+    for (int j = firstCol; j < activeCols; j++) {
+      int height = colHeight[j];
+      if (height == 0) {
+        undo.emptiedCols.push_back(j);
+        continue;
+      }
       if (j != col) {
-        for (int i = 0; i < rows; i++) {
-          int nodeIdx = nodeGrid[i][j];
-          nodeGrid[i][col] = nodeIdx;
-          nodeGrid[i][j] = -1;
-          if (nodeIdx != -1) {
-            nodes[nodeIdx].col = col;
-          }
+        char *from = &tiles[j * rows];
+        char *to = &tiles[col * rows];
+        for (int h = 0; h < height; h++) {
+          to[h] = from[h];
+          from[h] = EMPTY;
+          boardHash ^= zobrist::tileKey(rows - 1 - h, j, to[h]) ^
+                       zobrist::tileKey(rows - 1 - h, col, to[h]);
         }
+        colHeight[col] = height;
+        colHeight[j] = 0;
       }
       col++;
     }
+    collapsed = activeCols - col;
+    lastCol = activeCols - 1;
+    activeCols = col;
   }
 
-  updateNeighbors();
+  undo.firstChangedCol = firstCol;
+  undo.lastChangedCol = lastCol;
+  undo.collapsedCols = collapsed;
 }
 
 bool SameGame::hasMovesLeft() {
-  for (const auto &node : nodes) {
-    if (node.active) {
-      int clusterSize = getClusterSize(node.row, node.col);
-      if (clusterSize >= 2) {
+  if (backend == BoardBackend::BitBoard)
+    return bits.hasMovesLeft();
+
+  // A move exists exactly when two adjacent tiles share a color. Empty
+  // cells hold EMPTY, which matches no tile.
+  for (int c = 0; c < activeCols; c++) {
+    const char *column = &tiles[c * rows];
+    for (int h = 0; h < colHeight[c]; h++) {
+      if ((h + 1 < rows && column[h + 1] == column[h]) ||
+          (c + 1 < activeCols && column[h + rows] == column[h])) {
         return true;
       }
     }
@@ -238,58 +516,140 @@ bool SameGame::hasMovesLeft() {
   return false;
 }
 
+void SameGame::collectClusters(vector<ClusterInfo> &out) {
+  out.clear();
+  if (backend == BoardBackend::BitBoard) {
+    bits.collectClusters(out);
+  } else {
+    labelClusters(out);
+  }
+}
+
 vector<tuple<int, char, int, int>> SameGame::getAllClusters() {
   vector<tuple<int, char, int, int>> clusters;
-  unordered_set<int> visited;
+  collectMoves(clusters);
+  return clusters;
+}
 
-  for (int nodeIdx = 0; nodeIdx < (int)nodes.size(); nodeIdx++) {
-    const auto &node = nodes[nodeIdx];
-    if (node.active && visited.find(nodeIdx) == visited.end()) {
-      vector<pair<int, int>> cluster = detectClusterBFS(node.row, node.col);
+// getAllClusters() into a buffer the caller keeps
+void SameGame::collectMoves(vector<tuple<int, char, int, int>> &out) {
+  collectClusters(clusterInfo);
+  out.clear();
+  for (const ClusterInfo &info : clusterInfo) {
+    out.push_back({info.size, info.color, info.row, info.col});
+  }
+}
 
-      for (const auto &tile : cluster) {
-        int idx = getNodeIndex(tile.first, tile.second);
-        if (idx != -1) {
-          visited.insert(idx);
-        }
-      }
+vector<ClusterInfo> SameGame::getClusterInfo() {
+  collectClusters(clusterInfo);
+  return clusterInfo;
+}
 
-      if (cluster.size() >= 2) {
-        clusters.push_back(
-            {(int)cluster.size(), node.color, node.row, node.col});
-      }
+// The move list of the current position if it is cached. `tiles` is
+// tileHash(), so both sides share the entry for a board.
+bool SameGame::cachedClusters(uint64_t tiles, ClusterList &out) {
+  bool cached = clusterCache.find(tiles, out);
+#ifdef SAMEGAME_DEBUG_HASH
+  if (cached) {
+    collectClusters(clusterInfo);
+    assert(out.size() == clusterInfo.size());
+    for (size_t i = 0; i < clusterInfo.size(); i++) {
+      assert(out[i].row == clusterInfo[i].row &&
+             out[i].col == clusterInfo[i].col &&
+             out[i].size == clusterInfo[i].size);
     }
   }
+#endif
+  return cached;
+}
 
-  return clusters;
+ClusterList SameGame::generateClusters(uint64_t tiles) {
+  collectClusters(clusterInfo);
+  return clusterCache.store(tiles, clusterInfo);
 }
 
-SameGame::BoardSnapshot SameGame::saveState() {
-  BoardSnapshot snap;
-  snap.nodes = nodes;
-  snap.nodeGrid = nodeGrid;
-  snap.score = score;
-  snap.moves = moves;
-  snap.isUserTurn = isUserTurn;
-  snap.userScore = userScore;
-  snap.computerScore = computerScore;
-  return snap;
+int SameGame::findRoot(int cell) {
+  while (ccParent[cell] != cell) {
+    ccParent[cell] = ccParent[ccParent[cell]]; // path halving
+    cell = ccParent[cell];
+  }
+  return cell;
+}
+
+// Pass 1 of the labelling: links every tile of the first `linkedCols`
+// columns of `grid`, laid out like `tiles`, with its same-color neighbors
+// below and left. Empty cells get parent -1.
+void SameGame::linkClusters(const char *grid, int linkedCols) {
+  int n = rows * linkedCols;
+  ccParent.resize(n);
+  ccSlot.resize(n);
+  for (int c = 0; c < linkedCols; c++) {
+    for (int h = 0; h < rows; h++) {
+      int cell = c * rows + h;
+      char color = grid[cell];
+      if (color == EMPTY) {
+        ccParent[cell] = -1;
+        continue;
+      }
+      ccParent[cell] = cell;
+
+      if (h > 0 && grid[cell - 1] == color) {
+        ccParent[cell] = findRoot(cell - 1);
+      }
+      if (c > 0 && grid[cell - rows] == color) {
+        int a = findRoot(cell);
+        int b = findRoot(cell - rows);
+        if (a < b)
+          ccParent[b] = a;
+        else
+          ccParent[a] = b;
+      }
+    }
+  }
 }
 
-void SameGame::restoreState(const BoardSnapshot &snap) {
-  nodes = snap.nodes;
-  nodeGrid = snap.nodeGrid;
-  score = snap.score;
-  moves = snap.moves;
-  isUserTurn = snap.isUserTurn;
-  userScore = snap.userScore;
-  computerScore = snap.computerScore;
+// Two-pass union-find labelling of every same-color component.
+//
+// Cells are numbered column by column from the bottom (cell = col * rows +
+// rows - 1 - row), and a union always keeps the smaller number as the root,
+// so each root is the first tile scanned: the lowest tile of the cluster's
+// leftmost column, the same representative the bitboard backend reports.
+void SameGame::labelClusters(vector<ClusterInfo> &out) {
+  int n = rows * activeCols;
+  linkClusters(tiles.data(), activeCols);
+
+  // Pass 2: accumulate size and bounding box per root, in scan order
+  size_t first = out.size();
+  for (int cell = 0; cell < n; cell++) {
+    if (ccParent[cell] == -1)
+      continue;
+    int c = cell / rows;
+    int r = rows - 1 - cell % rows;
+    int root = findRoot(cell);
+    if (root == cell) {
+      ccSlot[cell] = out.size();
+      out.push_back({1, tiles[cell], r, c, r, r, c, c});
+      continue;
+    }
+    ClusterInfo &info = out[ccSlot[root]];
+    info.size++;
+    info.minRow = min(info.minRow, r);
+    info.maxRow = max(info.maxRow, r);
+    info.maxCol = c;
+  }
+
+  // Single tiles are not moves
+  out.erase(remove_if(out.begin() + first, out.end(),
+                      [](const ClusterInfo &info) { return info.size < 2; }),
+            out.end());
 }
 
 // ============================================================
 //                    AI ENGINE — OVERHAULED
 // ============================================================
 
+#ifdef SAMEGAME_DEBUG_HASH
+// Full position string, only used to verify Zobrist hashes in debug builds.
 string SameGame::boardStateKey() {
   string key;
   key.reserve(rows * cols + 5);
@@ -298,53 +658,213 @@ string SameGame::boardStateKey() {
 
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < cols; j++) {
-      int idx = nodeGrid[i][j];
-      if (idx != -1 && nodes[idx].active) {
-        key += nodes[idx].color;
-      } else {
-        key += '.';
-      }
+      key += isTileActive(i, j) ? getTile(i, j) : '.';
     }
   }
   return key;
 }
+#endif
+
+void SameGame::initEvalTerms() {
+  colAdjacency.assign(cols, 0);
+  colIsolated.assign(cols, 0);
+  adjacencyTotal = 0;
+  isolatedTotal = 0;
+  activeTotal = 0;
+  colorTotal.fill(0);
+  for (int c = 0; c < cols; c++) {
+    colAdjacency[c] = columnAdjacencies(c, rows - 1);
+    colIsolated[c] = columnIsolated(c, rows - 1);
+    adjacencyTotal += colAdjacency[c];
+    isolatedTotal += colIsolated[c];
+  }
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      if (isTileActive(i, j)) {
+        activeTotal++;
+        colorTotal[(unsigned char)getTile(i, j)]++;
+      }
+    }
+  }
+}
+
+// Graph backend, before the cluster is removed: the shares over the rows the
+// move can change, so updateEvalTerms can recount just those rows.
+void SameGame::recordEvalRows(int firstCol, int lastCol, int lastRow,
+                              MoveUndo &undo) {
+  int lo = max(0, firstCol - 1);
+  int hi = min(cols - 1, lastCol + 1);
+  undo.evalLastRow = lastRow;
+  undo.rowsAdjacencyBefore.clear();
+  undo.rowsIsolatedBefore.clear();
+  for (int c = lo; c <= hi; c++) {
+    undo.rowsAdjacencyBefore.push_back(columnAdjacencies(c, lastRow));
+    undo.rowsIsolatedBefore.push_back(columnIsolated(c, lastRow));
+  }
+}
+
+// Called after a move has been applied and its changed columns recorded.
+void SameGame::updateEvalTerms(MoveUndo &undo) {
+  activeTotal -= undo.removed;
+  colorTotal[(unsigned char)undo.color] -= undo.removed;
+
+  // A column's shares also depend on its neighbours' tiles
+  int lo = max(0, undo.firstChangedCol - 1);
+  int hi = min(cols - 1, undo.lastChangedCol + 1);
+  undo.evalFirstCol = lo;
+  undo.adjacencyBefore = adjacencyTotal;
+  undo.isolatedBefore = isolatedTotal;
+  undo.colAdjacencyBefore.assign(colAdjacency.begin() + lo,
+                                 colAdjacency.begin() + hi + 1);
+  undo.colIsolatedBefore.assign(colIsolated.begin() + lo,
+                                colIsolated.begin() + hi + 1);
+
+  // Without a collapse the graph backend's columns only changed above
+  // evalLastRow
+  bool partial = backend != BoardBackend::BitBoard && undo.collapsedCols == 0;
+  int lastRow = partial ? undo.evalLastRow : rows - 1;
+  for (int c = lo; c <= hi; c++) {
+    int adjacent = columnAdjacencies(c, lastRow);
+    int isolated = columnIsolated(c, lastRow);
+    if (partial) {
+      adjacent += colAdjacency[c] - undo.rowsAdjacencyBefore[c - lo];
+      isolated += colIsolated[c] - undo.rowsIsolatedBefore[c - lo];
+    }
+    adjacencyTotal += adjacent - colAdjacency[c];
+    isolatedTotal += isolated - colIsolated[c];
+    colAdjacency[c] = adjacent;
+    colIsolated[c] = isolated;
+  }
+}
+
+void SameGame::restoreEvalTerms(const MoveUndo &undo) {
+  activeTotal += undo.removed;
+  colorTotal[(unsigned char)undo.color] += undo.removed;
+  adjacencyTotal = undo.adjacencyBefore;
+  isolatedTotal = undo.isolatedBefore;
+  copy(undo.colAdjacencyBefore.begin(), undo.colAdjacencyBefore.end(),
+       colAdjacency.begin() + undo.evalFirstCol);
+  copy(undo.colIsolatedBefore.begin(), undo.colIsolatedBefore.end(),
+       colIsolated.begin() + undo.evalFirstCol);
+}
+
+// Same-color pairs inside the column and between it and the next column.
+// Every tile of a column sits in its bottom colHeight cells after gravity;
+// rows up to lastRow are heights from rows - 1 - lastRow up.
+int SameGame::columnAdjacencies(int col, int lastRow) const {
+  if (backend == BoardBackend::BitBoard)
+    return bits.columnAdjacencies(col);
+  if (col >= activeCols)
+    return 0;
 
-// Count how many pairs of adjacent same-color active tiles exist.
-// Higher = more clusters possible = more "alive" the board is.
-int SameGame::countColorAdjacencies() {
   int adj = 0;
-  for (const auto &node : nodes) {
-    if (!node.active)
-      continue;
-    for (int nIdx : node.neighbors) {
-      if (nodes[nIdx].active && nodes[nIdx].color == node.color) {
-        adj++;
+  const char *column = &tiles[col * rows];
+  bool hasRight = col + 1 < activeCols;
+  for (int h = rows - 1 - lastRow; h < colHeight[col]; h++) {
+    if (h > 0 && column[h - 1] == column[h])
+      adj++;
+    if (hasRight && column[h + rows] == column[h])
+      adj++;
+  }
+  return adj;
+}
+
+// Tiles in the column with no same-color neighbor; they can never be part
+// of a move.
+int SameGame::columnIsolated(int col, int lastRow) const {
+  if (backend == BoardBackend::BitBoard)
+    return bits.columnIsolated(col);
+  if (col >= activeCols)
+    return 0;
+
+  int isolated = 0;
+  const char *column = &tiles[col * rows];
+  for (int h = rows - 1 - lastRow; h < colHeight[col]; h++) {
+    char color = column[h];
+    bool hasNeighbor = (h > 0 && column[h - 1] == color) ||
+                       (h + 1 < rows && column[h + 1] == color) ||
+                       (col > 0 && column[h - rows] == color) ||
+                       (col + 1 < activeCols && column[h + rows] == color);
+    if (!hasNeighbor)
+      isolated++;
+  }
+  return isolated;
+}
+
+#ifdef SAMEGAME_DEBUG_HASH
+// Recounts every evaluation term from scratch
+void SameGame::verifyEvalTerms() const {
+  // Read every cell once; the recount below only looks at this copy
+  vector<char> grid(rows * cols);
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      grid[i * cols + j] = isTileActive(i, j) ? getTile(i, j) : EMPTY;
+    }
+  }
+
+  int adjacent = 0, isolated = 0, active = 0;
+  array<int, 256> colors = {};
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      char color = grid[i * cols + j];
+      if (color == EMPTY)
+        continue;
+      active++;
+      colors[(unsigned char)color]++;
+      bool hasNeighbor = false;
+      for (int dir = 0; dir < 4; dir++) {
+        int r = i + DIR_ROW[dir], c = j + DIR_COL[dir];
+        if (r < 0 || r >= rows || c < 0 || c >= cols ||
+            grid[r * cols + c] != color)
+          continue;
+        hasNeighbor = true;
+        if (dir == 1 || dir == 2)
+          adjacent++; // right and down, so each pair counts once
       }
+      if (!hasNeighbor)
+        isolated++;
     }
   }
-  return adj / 2; // each edge counted twice
+  assert(adjacent == adjacencyTotal);
+  assert(isolated == isolatedTotal);
+  assert(active == activeTotal);
+  assert(colors == colorTotal);
+}
+#endif
+
+// Count how many pairs of adjacent same-color active tiles exist.
+// Higher = more clusters possible = more "alive" the board is.
+int SameGame::countColorAdjacencies() { return adjacencyTotal; }
+
+// Tiles with no same-color neighbor can never be part of a move.
+int SameGame::countIsolatedTiles() { return isolatedTotal; }
+
+int SameGame::countActiveTiles() { return activeTotal; }
+
+int SameGame::countColorTiles(char color) {
+  return colorTotal[(unsigned char)color];
 }
 
 // Strategic evaluation: called when search depth is exhausted.
 // Positive = good for computer, negative = good for user.
-int SameGame::evaluateStrategic() {
+int SameGame::evaluateStrategic(ClusterList clusters) {
   // 1) Raw score differential — most important signal
-  int eval = (computerScore - userScore) * 100;
+  long long eval = (computerScore - userScore) * 100;
 
-  // 2) Gather all available clusters
-  vector<tuple<int, char, int, int>> clusters = getAllClusters();
-
-  // Sort clusters by size descending
-  sort(clusters.begin(), clusters.end(),
-       [](const auto &a, const auto &b) { return get<0>(a) > get<0>(b); });
+  // 2) Cluster sizes, largest first
+  clusterSizes.clear();
+  for (const ClusterInfo &cluster : clusters) {
+    clusterSizes.push_back(cluster.size);
+  }
+  sort(clusterSizes.begin(), clusterSizes.end(), greater<int>());
 
   // 3) Turn-aware cluster potential attribution:
   //    The current player gets the largest cluster, opponent gets the next,
   //    etc. This simulates the alternating-turn reality.
   bool compTurn = !isUserTurn; // from computer's perspective
-  for (int i = 0; i < (int)clusters.size(); i++) {
-    int sz = get<0>(clusters[i]);
-    int points = (sz - 2) * (sz - 2);
+  for (int i = 0; i < (int)clusterSizes.size(); i++) {
+    long long sz = clusterSizes[i];
+    long long points = (sz - 2) * (sz - 2);
 
     bool thisTurnIsComputer = (i % 2 == 0) ? compTurn : !compTurn;
     if (thisTurnIsComputer) {
@@ -356,9 +876,9 @@ int SameGame::evaluateStrategic() {
 
   // 4) Cluster-denial: penalise states where the opponent's NEXT move
   //    has a huge cluster (>= 4 tiles).
-  if (!clusters.empty() && !compTurn) {
+  if (!clusterSizes.empty() && !compTurn) {
     // It's the user's turn next — if the biggest cluster is huge, bad for us
-    int biggestForUser = get<0>(clusters[0]);
+    long long biggestForUser = clusterSizes[0];
     if (biggestForUser >= 4) {
       eval -= biggestForUser * biggestForUser * 2;
     }
@@ -366,22 +886,8 @@ int SameGame::evaluateStrategic() {
 
   // 5) Isolated tile penalty — tiles with no same-color neighbor are dead
   // weight
-  int isolatedCount = 0;
-  int activeTiles = 0;
-  for (const auto &node : nodes) {
-    if (!node.active)
-      continue;
-    activeTiles++;
-    bool hasNeighbor = false;
-    for (int neighborIdx : node.neighbors) {
-      if (nodes[neighborIdx].active && nodes[neighborIdx].color == node.color) {
-        hasNeighbor = true;
-        break;
-      }
-    }
-    if (!hasNeighbor)
-      isolatedCount++;
-  }
+  int isolatedCount = countIsolatedTiles();
+  int activeTiles = countActiveTiles();
   eval -= isolatedCount * 8;
 
   // 6) Connectivity bonus — more same-color adjacencies = healthier board
@@ -403,17 +909,17 @@ int SameGame::evaluateStrategic() {
     eval += 1000;
   }
 
-  return eval;
+  return clampValue(eval);
 }
 
 // Smart move ordering: prioritise moves that are likely best.
 // Better ordering → more alpha-beta cutoffs → deeper effective search.
 int SameGame::getSmartMoveHeuristic(int clusterSize, int row, int col,
                                     char color) {
-  int h = 0;
+  long long h = 0;
 
   // a) Immediate points — biggest factor
-  int points = (clusterSize - 2) * (clusterSize - 2);
+  long long points = (long long)(clusterSize - 2) * (clusterSize - 2);
   h += points * 1000;
 
   // b) Larger clusters are always more attractive even below the quadratic
@@ -430,114 +936,470 @@ int SameGame::getSmartMoveHeuristic(int clusterSize, int row, int col,
 
   // e) Color frequency bonus: removing a color that has many tiles
   //    increases consolidation chances for remaining colors
-  int colorCount = 0;
-  for (const auto &node : nodes) {
-    if (node.active && node.color == color)
-      colorCount++;
-  }
+  int colorCount = countColorTiles(color);
   // Prefer removing dominant colors in large chunks
   if (clusterSize * 3 >= colorCount && colorCount >= 4) {
     h += 500; // this removes a big fraction of this color
   }
 
-  return h;
+  return clampValue(h);
+}
+
+// Same anchor and same color: the cluster can only have grown or shrunk
+int SameGame::killerKey(char color, int cell) {
+  return cell * 256 + (unsigned char)color;
+}
+
+int SameGame::historyIndex(char color, int cell) const {
+  return ((unsigned char)color * 0x9E3779B1u ^ cell) & (HISTORY_SIZE - 1);
+}
+
+// Called when a search starts: killers only hold for the tree they came
+// from, history fades so older searches count for less.
+void SameGame::ageMoveOrdering() {
+  killers.assign(limits.maxDepth + 1, {-1, -1});
+  for (int &score : history) {
+    score /= 2;
+  }
+}
+
+void SameGame::recordCutoff(int ply, int depth, const ClusterInfo &move) {
+  int cell = move.row * cols + move.col;
+  int killer = killerKey(move.color, cell);
+  array<int, 2> &slots = killers[ply];
+  if (slots[0] != killer) {
+    slots[1] = slots[0];
+    slots[0] = killer;
+  }
+  // Cutoffs near the root save the most work
+  int &score = history[historyIndex(move.color, cell)];
+  score = min(score + depth * depth, HISTORY_MAX);
 }
 
 // Alpha-beta minimax with transposition table.
 // Positive values favor the computer, negative favor the user.
+bool SameGame::outOfBudget() {
+  if (stopSignal && stopSignal->load(memory_order_relaxed))
+    return true;
+  if (limits.maxNodes > 0 && searchNodes >= limits.maxNodes)
+    return true;
+  // Reading the clock every node would cost more than the nodes themselves,
+  // except on big boards, where a node costs far more than the clock
+  return limits.timeMs > 0 && (searchNodes & (clockInterval - 1)) == 0 &&
+         chrono::steady_clock::now() >= searchDeadline;
+}
+
+template <bool WithStats>
 int SameGame::alphaBeta(int depth, int alpha, int beta) {
-  // Terminal check
-  if (!hasMovesLeft()) {
-    int activeTiles = 0;
-    for (const auto &node : nodes) {
-      if (node.active)
-        activeTiles++;
+  using Clock = chrono::steady_clock;
+  Clock::time_point phaseStart;
+
+  if (searchAborted)
+    return 0;
+  searchNodes++;
+  if (outOfBudget()) {
+    searchAborted = true;
+    return 0;
+  }
+  if constexpr (WithStats) {
+    stats->maxPly = max(stats->maxPly, rootDepth - depth);
+  }
+
+  // Terminal check. A cached move list answers it; otherwise hasMovesLeft()
+  // is cheaper than generating a list that a TT cutoff may never need.
+  uint64_t tiles = tileHash();
+  ClusterList moves;
+  bool cached = cachedClusters(tiles, moves);
+  if (cached ? moves.empty() : !hasMovesLeft()) {
+    if constexpr (WithStats) {
+      stats->terminalNodes++;
+      phaseStart = Clock::now();
     }
+    int activeTiles = countActiveTiles();
     int clearBonus = (activeTiles == 0) ? 1000 : -activeTiles * 10;
-    return (computerScore - userScore) * 100 + clearBonus;
+    int value = clampValue((computerScore - userScore) * 100 + clearBonus);
+    if constexpr (WithStats) {
+      stats->evalTime += Clock::now() - phaseStart;
+    }
+    return value;
   }
 
   // Depth exhausted — use strategic evaluation
   if (depth <= 0) {
-    return evaluateStrategic();
+    horizonReached = true;
+    if constexpr (WithStats) {
+      stats->leafEvaluations++;
+      phaseStart = Clock::now();
+      int value = evaluateStrategic(cached ? moves : generateClusters(tiles));
+      stats->evalTime += Clock::now() - phaseStart;
+      return value;
+    }
+    return evaluateStrategic(cached ? moves : generateClusters(tiles));
   }
 
-  // Transposition table lookup
-  string key = boardStateKey();
-  auto it = transTable.find(key);
-  if (it != transTable.end()) {
-    TTEntry &entry = it->second;
-    if (entry.depth >= depth) {
-      if (entry.flag == 0)
-        return entry.value; // exact
-      if (entry.flag == 1)
-        alpha = max(alpha, entry.value); // lower bound
-      if (entry.flag == 2)
-        beta = min(beta, entry.value); // upper bound
-      if (alpha >= beta)
-        return entry.value;
+  // Transposition table lookup. Values are stored relative to the score
+  // difference already banked, so an entry stays valid when the same board is
+  // reached with different scores, e.g. on a later turn.
+  uint64_t key = getHash();
+  long long scoreBase = (computerScore - userScore) * 100;
+  int ttMove = -1;
+  TTEntry hit;
+  bool found = transTable->probe(key, hit);
+  if constexpr (WithStats) {
+    stats->ttProbes++;
+  }
+#ifdef SAMEGAME_DEBUG_HASH
+  uint64_t boardCheck = std::hash<string>()(boardStateKey());
+  if (found && hit.boardCheck != boardCheck) {
+    hashCollisions++;
+    found = false; // a collision is treated as a miss
+  }
+#endif
+  if (found) {
+    if constexpr (WithStats) {
+      stats->ttHits++;
+    }
+    ttMove = hit.bestMove;
+    if (hit.depth >= depth) {
+      // The stored search may itself have stopped at a depth limit
+      horizonReached = true;
+      int value = clampValue(hit.value + scoreBase);
+      if (hit.flag == 1)
+        alpha = max(alpha, value); // lower bound
+      if (hit.flag == 2)
+        beta = min(beta, value); // upper bound
+      if (hit.flag == 0 || alpha >= beta) {
+        if constexpr (WithStats) {
+          stats->ttCutoffs++;
+        }
+        return value;
+      }
     }
   }
 
-  vector<tuple<int, char, int, int>> clusters = getAllClusters();
+  if constexpr (WithStats) {
+    phaseStart = Clock::now();
+  }
 
-  // Move ordering: sort by heuristic score descending
-  vector<pair<int, int>> moveOrder;
+  // Children overwrite cache slots, so this node keeps its own copy
+  int ply = rootDepth - depth;
+  PlyScratch &scratch = plyScratch[ply];
+  vector<ClusterInfo> &clusters = scratch.clusters;
+  if (!cached)
+    moves = generateClusters(tiles);
+  clusters.assign(moves.begin(), moves.end());
+
+  // Move ordering: sort by heuristic score descending, best move from the
+  // transposition table first, then this ply's killers, with moves that
+  // caused cutoffs elsewhere moved up
+  const array<int, 2> &killer = killers[ply];
+  vector<pair<int, int>> &moveOrder = scratch.moveOrder;
+  moveOrder.clear();
   for (int i = 0; i < (int)clusters.size(); i++) {
-    int h = getSmartMoveHeuristic(get<0>(clusters[i]), get<2>(clusters[i]),
-                                  get<3>(clusters[i]), get<1>(clusters[i]));
+    const ClusterInfo &c = clusters[i];
+    int cell = c.row * cols + c.col;
+    int h = getSmartMoveHeuristic(c.size, c.row, c.col, c.color) +
+            history[historyIndex(c.color, cell)] * HISTORY_WEIGHT;
+    int key = killerKey(c.color, cell);
+    if (key == killer[0])
+      h += KILLER_BONUS;
+    else if (key == killer[1])
+      h += KILLER_BONUS / 2;
+    if (cell == ttMove)
+      h = INT_MAX;
     moveOrder.push_back({h, i});
   }
   sort(moveOrder.begin(), moveOrder.end(), greater<pair<int, int>>());
+  if constexpr (WithStats) {
+    stats->moveGenTime += Clock::now() - phaseStart;
+  }
 
   bool maximizing = !isUserTurn; // Computer maximizes
   int bestVal = maximizing ? INT_MIN : INT_MAX;
+  int bestIdx = -1;
   int origAlpha = alpha;
+  int origBeta = beta;
+  MoveUndo &undo = scratch.undo;
+  int moveNumber = 0;
 
   for (const auto &[heuristic, idx] : moveOrder) {
-    BoardSnapshot snap = saveState();
-    removeCluster(get<2>(clusters[idx]), get<3>(clusters[idx]));
+    if constexpr (WithStats) {
+      phaseStart = Clock::now();
+    }
+    makeMove(clusters[idx].row, clusters[idx].col, undo);
+    if constexpr (WithStats) {
+      stats->makeUnmakeTime += Clock::now() - phaseStart;
+    }
 
-    int val = alphaBeta(depth - 1, alpha, beta);
+    int val = alphaBeta<WithStats>(depth - 1, alpha, beta);
 
-    restoreState(snap);
+    if constexpr (WithStats) {
+      phaseStart = Clock::now();
+    }
+    unmakeMove(undo);
+    if constexpr (WithStats) {
+      stats->makeUnmakeTime += Clock::now() - phaseStart;
+    }
 
+    if (maximizing ? val > bestVal : val < bestVal) {
+      bestVal = val;
+      bestIdx = idx;
+    }
     if (maximizing) {
-      bestVal = max(bestVal, val);
       alpha = max(alpha, val);
     } else {
-      bestVal = min(bestVal, val);
       beta = min(beta, val);
     }
 
     // Alpha-beta cutoff
     if (alpha >= beta) {
+      if (!searchAborted)
+        recordCutoff(ply, depth, clusters[idx]);
+      if constexpr (WithStats) {
+        if (!searchAborted)
+          stats->betaCutoffs[min(moveNumber, SearchStats::CUTOFF_SLOTS - 1)]++;
+      }
       break;
     }
+    moveNumber++;
   }
 
+  // An interrupted search proves nothing; keep it out of the table
+  if (searchAborted)
+    return 0;
+  if (!storableValue(bestVal, scoreBase))
+    return bestVal;
+
   // Store in transposition table
   TTEntry entry;
-  entry.value = bestVal;
+  entry.key = key;
+  entry.value = (int)(bestVal - scoreBase);
   entry.depth = depth;
+  entry.bestMove =
+      bestIdx >= 0 ? clusters[bestIdx].row * cols + clusters[bestIdx].col : -1;
   if (bestVal <= origAlpha) {
     entry.flag = 2; // upper bound
-  } else if (bestVal >= beta) {
+  } else if (bestVal >= origBeta) {
     entry.flag = 1; // lower bound
   } else {
     entry.flag = 0; // exact
   }
-  transTable[key] = entry;
+#ifdef SAMEGAME_DEBUG_HASH
+  entry.boardCheck = boardCheck;
+#endif
+  transTable->store(entry);
+
+  return bestVal;
+}
+
+// ============================================================
+//                    EXACT ENDGAME SOLVER
+// ============================================================
+
+// Solves the position exactly if it is small enough, with half of the
+// search budget. On success `move` is the best move and provenLead the
+// final score difference.
+bool SameGame::solveEndgame(pair<int, int> &move) {
+  if (limits.solveTiles <= 0 || countActiveTiles() > limits.solveTiles ||
+      (int)rootClusters.size() > limits.solveClusters)
+    return false;
+
+  // reserveSearchScratch() has sized plyScratch and the table
+  solveColors.clear();
+  for (int c = 0; c < 256; c++) {
+    if (colorTotal[c] > 0)
+      solveColors.push_back((char)c);
+  }
+
+  SearchLimits full = limits;
+  chrono::steady_clock::time_point fullDeadline = searchDeadline;
+  limits.maxNodes = (full.maxNodes + 1) / 2;
+  // Half of what the setup left, so a failed solve still leaves the search
+  // the other half
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  searchDeadline = now + (fullDeadline - now) / 2;
+  searchAborted = false;
+  solveMaxPly = 0;
+  int value = solve(0, -SOLVE_LIMIT, SOLVE_LIMIT);
+  limits = full;
+  searchDeadline = fullDeadline;
+  if (searchAborted) {
+    searchAborted = false;
+    return false;
+  }
+
+  move = {solvedRootMove / cols, solvedRootMove % cols};
+  long long lead = computerScore - userScore;
+  provenLead = isUserTurn ? lead - value : lead + value;
+  lastSolved = true;
+  lastSearchDepth = solveMaxPly;
+  return true;
+}
+
+// The slot holding `key`, or the empty slot it would go in; nullptr when
+// every slot it may use belongs to another board
+SolvedPosition *SameGame::findSolved(uint64_t key) {
+  vector<SolvedPosition> &table = *solvedTable;
+  size_t mask = table.size() - 1;
+  for (int i = 0; i < SOLVED_PROBES; i++) {
+    SolvedPosition &slot = table[(key + i) & mask];
+    if (slot.key == key || slot.key == 0)
+      return &slot;
+  }
+  return nullptr;
+}
+
+// Most the side to move can still gain over its opponent: every remaining
+// tile of each color taken in one cluster, and nothing for the opponent
+int SameGame::remainingPointsBound() const {
+  int bound = 0;
+  for (char color : solveColors) {
+    int n = colorTotal[(unsigned char)color];
+    if (n > 2)
+      bound += (n - 2) * (n - 2);
+  }
+  return bound;
+}
+
+// Negamax value of the rest of the game for the side to move: the points
+// it gains minus the points its opponent gains, with best play from both.
+// Fail-soft alpha-beta; the table records bounds as well as exact values.
+int SameGame::solve(int ply, int alpha, int beta) {
+  if (searchAborted)
+    return 0;
+  searchNodes++;
+  if (outOfBudget()) {
+    searchAborted = true;
+    return 0;
+  }
+  solveMaxPly = max(solveMaxPly, ply);
+
+  uint64_t tiles = tileHash();
+  ClusterList moves;
+  bool cached = cachedClusters(tiles, moves);
+  if (cached ? moves.empty() : !hasMovesLeft())
+    return 0;
+
+  // Solution-size pruning: neither side can gain more than the bound
+  int bound = remainingPointsBound();
+  if (bound <= alpha)
+    return bound;
+  if (-bound >= beta)
+    return -bound;
+
+  // The root always searches its moves, so that it has a best move to play
+  SolvedPosition *entry = findSolved(tiles);
+  bool found = entry && entry->key == tiles;
+  int ttMove = found ? entry->bestMove : -1;
+  if (found && ply > 0) {
+    if (entry->lower >= beta || entry->lower == entry->upper)
+      return entry->lower;
+    if (entry->upper <= alpha)
+      return entry->upper;
+    alpha = max(alpha, entry->lower);
+    beta = min(beta, entry->upper);
+  }
 
+  PlyScratch &scratch = plyScratch[ply];
+  vector<ClusterInfo> &clusters = scratch.clusters;
+  if (!cached)
+    moves = generateClusters(tiles);
+  clusters.assign(moves.begin(), moves.end());
+
+  // The table's move first, then the biggest clusters
+  vector<pair<int, int>> &moveOrder = scratch.moveOrder;
+  moveOrder.clear();
+  for (int i = 0; i < (int)clusters.size(); i++) {
+    const ClusterInfo &c = clusters[i];
+    moveOrder.push_back({c.row * cols + c.col == ttMove ? INT_MAX : c.size, i});
+  }
+  sort(moveOrder.begin(), moveOrder.end(), greater<pair<int, int>>());
+
+  int origAlpha = alpha;
+  int bestVal = INT_MIN;
+  int bestMove = -1;
+  MoveUndo &undo = scratch.undo;
+  for (const auto &[order, idx] : moveOrder) {
+    const ClusterInfo &c = clusters[idx];
+    int points = (c.size - 2) * (c.size - 2);
+    makeMove(c.row, c.col, undo);
+    int val = points - solve(ply + 1, points - beta, points - alpha);
+    unmakeMove(undo);
+    if (searchAborted)
+      return 0;
+
+    if (val > bestVal) {
+      bestVal = val;
+      bestMove = c.row * cols + c.col;
+    }
+    alpha = max(alpha, val);
+    if (alpha >= beta)
+      break;
+  }
+  if (ply == 0)
+    solvedRootMove = bestMove;
+
+  // The children may have claimed the empty slot found above, so look again:
+  // findSolved() only returns a slot that is empty or holds this position
+  entry = findSolved(tiles);
+  if (entry) {
+    if (entry->key != tiles)
+      *entry = {tiles, -SOLVE_LIMIT, SOLVE_LIMIT, -1};
+    if (bestVal <= origAlpha) {
+      entry->upper = min(entry->upper, bestVal);
+    } else {
+      entry->bestMove = bestMove;
+      if (bestVal >= beta) {
+        entry->lower = max(entry->lower, bestVal);
+      } else {
+        entry->lower = bestVal;
+        entry->upper = bestVal;
+      }
+    }
+  }
   return bestVal;
 }
 
 pair<int, int> SameGame::getBestMove() {
-  transTable.clear();
-  vector<tuple<int, char, int, int>> clusters = getAllClusters();
+  searchNodes = 0;
+  lastSearchDepth = 0;
+  lastSolved = false;
+  if (!stats)
+    return searchBestMove();
+
+  stats->reset();
+  long long lookupsBefore = clusterCache.getLookups();
+  long long hitsBefore = clusterCache.getHits();
+  auto start = chrono::steady_clock::now();
+  pair<int, int> move = searchBestMove();
+  stats->totalTime = chrono::steady_clock::now() - start;
+  stats->clusterCacheLookups = clusterCache.getLookups() - lookupsBefore;
+  stats->clusterCacheHits = clusterCache.getHits() - hitsBefore;
+  stats->completedDepth = lastSearchDepth;
+  stats->solved = lastSolved;
+  stats->nodes = searchNodes;
+  if (limits.engine == SearchEngine::MonteCarlo)
+    stats->maxPly = searchTree->lastDepth();
+  return move;
+}
+
+pair<int, int> SameGame::searchBestMove() {
+  // The budget covers the setup too: labelling a huge board and reserving
+  // its buffers take a noticeable part of it
+  searchDeadline =
+      chrono::steady_clock::now() + chrono::milliseconds(limits.timeMs);
+  vector<tuple<int, char, int, int>> &clusters = rootClusters;
+  collectMoves(clusters);
   if (clusters.empty())
     return {-1, -1};
 
+  reserveSearchScratch();
+
+  // --- Small endgames are solved exactly ---
+  pair<int, int> solvedMove;
+  if (solveEndgame(solvedMove))
+    return solvedMove;
+
   // --- Quick win check: if only 1 cluster, take it ---
   if (clusters.size() == 1) {
     return {get<2>(clusters[0]), get<3>(clusters[0])};
@@ -545,75 +1407,408 @@ pair<int, int> SameGame::getBestMove() {
 
   // --- Check for immediately winning moves ---
   // A move is immediately winning if after taking it, either no moves remain
-  // and computer leads, or the lead is insurmountable.
+  // and the side to move leads, or the lead is insurmountable. Big boards
+  // have more clusters than the time budget allows trying, so the check
+  // gets half of what is left and ordering the moves the other half.
+  bool computerToMove = !isUserTurn;
+  MoveUndo &undo = plyScratch[0].undo;
+  chrono::steady_clock::time_point checkStart = chrono::steady_clock::now();
+  chrono::steady_clock::time_point checkDeadline =
+      checkStart + (searchDeadline - checkStart) / 2;
   for (int i = 0; i < (int)clusters.size(); i++) {
-    BoardSnapshot snap = saveState();
+    if (limits.timeMs > 0 && chrono::steady_clock::now() >= checkDeadline)
+      break;
     int cr = get<2>(clusters[i]);
     int cc = get<3>(clusters[i]);
-    removeCluster(cr, cc);
+    makeMove(cr, cc, undo);
 
-    if (!hasMovesLeft() && computerScore > userScore) {
-      restoreState(snap);
+    long long lead = computerScore - userScore;
+    bool wins = !hasMovesLeft() && (computerToMove ? lead > 0 : lead < 0);
+    unmakeMove(undo);
+    if (wins) {
       return {cr, cc};
     }
-    restoreState(snap);
-  }
-
-  // --- Adaptive search depth based on branching factor ---
-  int numClusters = clusters.size();
-  int lookDepth;
-  if (numClusters <= 2) {
-    lookDepth = 20; // exhaustive
-  } else if (numClusters <= 3) {
-    lookDepth = 14;
-  } else if (numClusters <= 5) {
-    lookDepth = 10;
-  } else if (numClusters <= 8) {
-    lookDepth = 8;
-  } else if (numClusters <= 12) {
-    lookDepth = 6;
-  } else if (numClusters <= 20) {
-    lookDepth = 5;
+  }
+
+  if (limits.engine == SearchEngine::MonteCarlo) {
+    // Playouts get whatever time and node budget the setup and an endgame
+    // solve left
+    SearchLimits remaining = limits;
+    if (remaining.timeMs > 0) {
+      auto left = chrono::duration_cast<chrono::milliseconds>(
+          searchDeadline - chrono::steady_clock::now());
+      remaining.timeMs = max(1, (int)left.count());
+    }
+    if (remaining.maxNodes > 0)
+      remaining.maxNodes = max(1LL, remaining.maxNodes - searchNodes);
+    pair<int, int> move = searchTree->search(*this, remaining, stopSignal);
+    searchNodes += searchTree->lastPlayouts();
+    lastSearchDepth = searchTree->lastDepth();
+    return move;
+  }
+
+  transTable->newSearch();
+  ageMoveOrdering();
+  vector<pair<int, int>> &moveOrder = rootOrder;
+  orderRootMoves(clusters, moveOrder);
+
+  // A pondered or earlier search of this position supplies the first move to
+  // try; only an exact entry is also a result to fall back on
+  TTEntry rootHit;
+  int rootIdx = -1;
+  if (probeRoot(rootHit)) {
+    for (auto &[key, idx] : moveOrder) {
+      if (get<2>(clusters[idx]) * cols + get<3>(clusters[idx]) ==
+          rootHit.bestMove) {
+        key = INT_MAX;
+        rootIdx = idx;
+      }
+    }
+    sort(moveOrder.begin(), moveOrder.end(), greater<pair<int, int>>());
+  }
+
+  // Fallback if not even the first iteration finishes in time
+  int bestIdx = moveOrder[0].second;
+
+  if (limits.threads <= 1) {
+    int idx = iterativeDeepening(clusters, moveOrder, 0);
+    if (idx >= 0)
+      bestIdx = idx;
   } else {
-    lookDepth = 4;
+    // --- Lazy SMP ---
+    // Helper threads search copies of the board and share only the
+    // transposition table. They run until this thread is done; whichever
+    // thread completed the deepest iteration supplies the move.
+    atomic<bool> stop(false);
+    vector<SameGame> helpers(limits.threads - 1, *this);
+    vector<int> helperBest(helpers.size(), -1);
+    vector<thread> workers;
+    for (int i = 0; i < (int)helpers.size(); i++) {
+      helpers[i].stopSignal = &stop;
+      helpers[i].stats = nullptr;
+      helpers[i].searchNodes = 0; // only this thread ran the solver
+      helpers[i].plyScratch.resize(plyScratch.size()); // copies start empty
+#ifdef SAMEGAME_DEBUG_HASH
+      helpers[i].hashCollisions = 0;
+#endif
+      workers.emplace_back([&, i] {
+        helperBest[i] =
+            helpers[i].iterativeDeepening(clusters, moveOrder, i + 1);
+      });
+    }
+
+    int idx = iterativeDeepening(clusters, moveOrder, 0);
+    stop.store(true, memory_order_relaxed);
+    for (thread &worker : workers) {
+      worker.join();
+    }
+
+    if (idx >= 0)
+      bestIdx = idx;
+    for (int i = 0; i < (int)helpers.size(); i++) {
+      if (helperBest[i] >= 0 &&
+          helpers[i].lastSearchDepth > lastSearchDepth) {
+        bestIdx = helperBest[i];
+        lastSearchDepth = helpers[i].lastSearchDepth;
+      }
+#ifdef SAMEGAME_DEBUG_HASH
+      hashCollisions += helpers[i].hashCollisions;
+#endif
+    }
   }
 
-  // --- Move ordering for the root ---
-  vector<pair<int, int>> moveOrder;
+  if (rootIdx >= 0 && rootHit.flag == 0 && rootHit.depth > lastSearchDepth) {
+    bestIdx = rootIdx;
+    lastSearchDepth = rootHit.depth;
+  }
+
+  return {get<2>(clusters[bestIdx]), get<3>(clusters[bestIdx])};
+}
+
+// Root moves sorted by the ordering heuristic, best first
+void SameGame::orderRootMoves(
+    const vector<tuple<int, char, int, int>> &clusters,
+    vector<pair<int, int>> &moveOrder) {
+  moveOrder.clear();
   for (int i = 0; i < (int)clusters.size(); i++) {
     int h = getSmartMoveHeuristic(get<0>(clusters[i]), get<2>(clusters[i]),
                                   get<3>(clusters[i]), get<1>(clusters[i]));
     moveOrder.push_back({h, i});
   }
   sort(moveOrder.begin(), moveOrder.end(), greater<pair<int, int>>());
+}
 
-  int bestScore = INT_MIN;
+// Next iteration searches the previous best move first and the rest in the
+// order of their previous scores
+void SameGame::reorderRootMoves(vector<pair<int, int>> &moveOrder,
+                                const vector<int> &values, int best) {
+  // Ties keep their current order. stable_sort would do that too, but
+  // allocates a buffer on every call.
+  rootPosition.resize(values.size());
+  for (int i = 0; i < (int)moveOrder.size(); i++) {
+    rootPosition[moveOrder[i].second] = i;
+  }
+  for (auto &[key, idx] : moveOrder) {
+    key = idx == best ? INT_MAX : values[idx];
+  }
+  sort(moveOrder.begin(), moveOrder.end(),
+       [&](const pair<int, int> &a, const pair<int, int> &b) {
+         if (a.first != b.first)
+           return a.first > b.first;
+         return rootPosition[a.second] < rootPosition[b.second];
+       });
+}
+
+// Every ply a search can reach gets its buffers before the search starts, so
+// plyScratch never moves while alphaBeta or solve holds references into it.
+// The buffers also get the most any position on this board can need: rows *
+// cols / 2 clusters, cols changed columns and, on the graph backend, rows *
+// cols saved tiles. Up to SCRATCH_RESERVE_BYTES, no later search grows
+// them; the deepest plies of huge boards grow on demand.
+void SameGame::reserveSearchScratch() {
+  transTable->reserve();
+  int tilesLeft = countActiveTiles();
+  int plies = limits.maxDepth + 1;
+  if (limits.solveTiles > 0)
+    plies = max(plies, min(limits.solveTiles, tilesLeft) / 2 + 1);
+  if ((int)plyScratch.size() < plies)
+    plyScratch.resize(plies);
+
+  size_t maxClusters = rows * cols / 2;
+  size_t savedTiles = backend == BoardBackend::Graph ? rows * cols : 0;
+  size_t perPly =
+      maxClusters * (sizeof(ClusterInfo) + sizeof(pair<int, int>)) +
+      savedTiles + cols * (7 * sizeof(int) + sizeof(BitBoard::ColumnChange));
+  // Every move takes at least two tiles, so no line goes deeper than this
+  int reachable = min(plies, tilesLeft / 2 + 1);
+  reachable = (int)min<size_t>(reachable, SCRATCH_RESERVE_BYTES / perPly);
+  for (int ply = 0; ply < reachable; ply++) {
+    PlyScratch &scratch = plyScratch[ply];
+    scratch.clusters.reserve(maxClusters);
+    scratch.moveOrder.reserve(maxClusters);
+    MoveUndo &undo = scratch.undo;
+    undo.columnTiles.reserve(savedTiles);
+    undo.emptiedCols.reserve(cols);
+    undo.colHeights.reserve(cols);
+    undo.colAdjacencyBefore.reserve(cols);
+    undo.colIsolatedBefore.reserve(cols);
+    undo.rowsAdjacencyBefore.reserve(cols);
+    undo.rowsIsolatedBefore.reserve(cols);
+    undo.bits.columns.reserve(cols);
+  }
+
+  // The root's move lists, and the flood fill queue
+  clusterInfo.reserve(maxClusters);
+  rootClusters.reserve(maxClusters);
+  rootOrder.reserve(maxClusters);
+  iterationOrder.reserve(maxClusters);
+  rootValues.reserve(maxClusters);
+  rootPosition.reserve(maxClusters);
+  fillCells.reserve(savedTiles);
+
+  // The endgame solver's table and its color list
+  if (limits.solveTiles > 0 && solvedTable->empty())
+    solvedTable->assign(SOLVED_TABLE_SIZE, {0, 0, 0, -1});
+  solveColors.reserve(256);
+}
+
+// Transposition table entry for the current position, checked for
+// collisions in debug builds like the lookups in alphaBeta.
+bool SameGame::probeRoot(TTEntry &out) {
+  if (!transTable->probe(getHash(), out) || out.bestMove < 0)
+    return false;
+#ifdef SAMEGAME_DEBUG_HASH
+  if (out.boardCheck != std::hash<string>()(boardStateKey())) {
+    hashCollisions++;
+    return false;
+  }
+#endif
+  return true;
+}
+
+// Searches every root move to `depth` in `moveOrder`, recording each move's
+// value from the point of view of the side to move. Returns the index of the
+// best cluster for that side, or -1 if the budget ran out first. A completed
+// iteration is also stored under the root position, so a later search of the
+// same position (e.g. after pondering) can reuse it.
+int SameGame::searchIteration(
+    const vector<tuple<int, char, int, int>> &clusters,
+    const vector<pair<int, int>> &moveOrder, int depth, vector<int> &values) {
+  horizonReached = false;
+  rootDepth = depth;
+  bool maximizing = !isUserTurn; // Computer maximizes
+  int bestScore = maximizing ? INT_MIN : INT_MAX;
   int bestClusterSize = 0;
-  pair<int, int> bestMove = {-1, -1};
+  int iterationBest = -1;
   int alpha = INT_MIN;
   int beta = INT_MAX;
+  MoveUndo &undo = plyScratch[0].undo;
 
   for (const auto &[heuristic, idx] : moveOrder) {
-    BoardSnapshot snap = saveState();
     int clusterRow = get<2>(clusters[idx]);
     int clusterCol = get<3>(clusters[idx]);
     int clusterSize = get<0>(clusters[idx]);
 
-    removeCluster(clusterRow, clusterCol);
+    makeMove(clusterRow, clusterCol, undo);
 
-    int val = alphaBeta(lookDepth, alpha, beta);
+    int val = stats ? alphaBeta<true>(depth - 1, alpha, beta)
+                    : alphaBeta<false>(depth - 1, alpha, beta);
 
-    restoreState(snap);
+    unmakeMove(undo);
 
-    if (val > bestScore ||
+    if (searchAborted)
+      return -1;
+
+    values[idx] = maximizing ? val : -val;
+    if ((maximizing ? val > bestScore : val < bestScore) ||
         (val == bestScore && clusterSize > bestClusterSize)) {
       bestScore = val;
       bestClusterSize = clusterSize;
-      bestMove = {clusterRow, clusterCol};
+      iterationBest = idx;
     }
 
-    alpha = max(alpha, val);
+    if (maximizing) {
+      alpha = max(alpha, val);
+    } else {
+      beta = min(beta, val);
+    }
+  }
+
+  // The best move was searched with an open window, so its value is exact
+  long long scoreBase = (computerScore - userScore) * 100;
+  if (!storableValue(bestScore, scoreBase))
+    return iterationBest;
+  TTEntry entry;
+  entry.key = getHash();
+  entry.value = (int)(bestScore - scoreBase);
+  entry.depth = depth;
+  entry.bestMove = get<2>(clusters[iterationBest]) * cols +
+                   get<3>(clusters[iterationBest]);
+  entry.flag = 0;
+#ifdef SAMEGAME_DEBUG_HASH
+  entry.boardCheck = std::hash<string>()(boardStateKey());
+#endif
+  transTable->store(entry);
+
+  return iterationBest;
+}
+
+// Searches the root one ply deeper at a time until the budget runs out and
+// returns the index of the best cluster of the last completed iteration, or
+// -1 if none completed. Helper threads (helper > 0) start from a rotated move
+// order and odd helpers skip depth 1, so that the threads spread over
+// different parts of the tree instead of repeating each other's work.
+int SameGame::iterativeDeepening(
+    const vector<tuple<int, char, int, int>> &clusters,
+    const vector<pair<int, int>> &rootMoveOrder, int helper) {
+  vector<pair<int, int>> &moveOrder = iterationOrder;
+  moveOrder.assign(rootMoveOrder.begin(), rootMoveOrder.end());
+  if (helper > 0) {
+    rotate(moveOrder.begin(),
+           moveOrder.begin() + helper % moveOrder.size(), moveOrder.end());
+  }
+
+  // Every move removes at least two tiles, so no line can be longer than this
+  int longestGame = countActiveTiles() / 2;
+
+  // searchNodes keeps counting from any endgame solve before this search, so
+  // the two share the node budget
+  searchAborted = false;
+  lastSearchDepth = 0;
+  int bestIdx = -1;
+
+  // Below the root, the transposition table's best moves replay the previous
+  // principal variation first.
+  vector<int> &values = rootValues;
+  values.assign(clusters.size(), 0);
+  for (int depth = 1 + helper % 2; depth <= limits.maxDepth; depth++) {
+    int iterationBest = searchIteration(clusters, moveOrder, depth, values);
+    if (iterationBest < 0)
+      break;
+
+    bestIdx = iterationBest;
+    lastSearchDepth = depth;
+
+    // Nothing was cut off by depth: the result is exact, deeper is pointless
+    if (!horizonReached || depth >= longestGame)
+      break;
+
+    reorderRootMoves(moveOrder, values, iterationBest);
+  }
+
+  return bestIdx;
+}
+
+void SameGame::ponder(int replies) {
+  if (!isUserTurn)
+    return;
+
+  // The tree covers every reply at once and is reused after the user moves
+  if (limits.engine == SearchEngine::MonteCarlo) {
+    searchTree->search(*this, limits, stopSignal);
+    return;
   }
 
-  return bestMove;
-}
\ No newline at end of file
+  searchDeadline =
+      chrono::steady_clock::now() + chrono::milliseconds(limits.timeMs);
+  transTable->newSearch();
+  ageMoveOrdering();
+  reserveSearchScratch();
+
+  // The computer's side of the search after each of the likely replies
+  struct Line {
+    int row, col;
+    vector<tuple<int, char, int, int>> clusters;
+    vector<pair<int, int>> moveOrder;
+    vector<int> values;
+    int longestGame;
+    bool done;
+  };
+  vector<Line> lines;
+
+  vector<tuple<int, char, int, int>> userMoves = getAllClusters();
+  vector<pair<int, int>> userOrder;
+  orderRootMoves(userMoves, userOrder);
+  MoveUndo undo;
+  for (int k = 0; k < (int)userOrder.size() && k < replies; k++) {
+    Line line;
+    line.row = get<2>(userMoves[userOrder[k].second]);
+    line.col = get<3>(userMoves[userOrder[k].second]);
+    makeMove(line.row, line.col, undo);
+    line.clusters = getAllClusters();
+    orderRootMoves(line.clusters, line.moveOrder);
+    line.values.assign(line.clusters.size(), 0);
+    line.longestGame = countActiveTiles() / 2;
+    line.done = line.clusters.size() < 2; // nothing to choose between
+    unmakeMove(undo);
+    lines.push_back(move(line));
+  }
+
+  searchNodes = 0;
+  searchAborted = false;
+
+  // Deepen all lines together so the likeliest replies never starve
+  for (int depth = 1; depth <= limits.maxDepth; depth++) {
+    bool pending = false;
+    for (Line &line : lines) {
+      if (line.done)
+        continue;
+
+      makeMove(line.row, line.col, undo);
+      int best = searchIteration(line.clusters, line.moveOrder, depth,
+                                 line.values);
+      line.done = best >= 0 && (!horizonReached || depth >= line.longestGame);
+      unmakeMove(undo);
+
+      if (searchAborted)
+        return;
+
+      reorderRootMoves(line.moveOrder, line.values, best);
+      pending = pending || !line.done;
+    }
+    if (!pending)
+      return;
+  }
+}
+
+size_t SameGame::getSearchTreeSize() const { return searchTree->size(); }
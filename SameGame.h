@@ -2,6 +2,7 @@
 #define SAMEGAME_H
 
 #include <vector>
+#include <array>
 #include <queue>
 #include <tuple>
 #include <utility>
@@ -9,91 +10,365 @@
 #include <unordered_set>
 #include <string>
 #include <climits>
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include "BitBoard.h"
+#include "TranspositionTable.h"
+#include "ClusterCache.h"
+#include "SearchStats.h"
 
 using namespace std;
 
-struct Node {
-    int row;
-    int col;
-    char color;
-    bool active;
-    vector<int> neighbors;
-    
-    Node(int r, int c, char clr) : row(r), col(c), color(clr), active(true) {}
+// Board representation used by the rules engine. Auto picks the graph, the
+// faster of the two; a BitBoard request on a board with more rows than fit
+// in a machine word gets the graph too.
+enum class BoardBackend {
+    Auto,
+    Graph,
+    BitBoard
+};
+
+class MonteCarloTree;
+
+// How getBestMove() searches: iterative-deepening alpha-beta, or UCT Monte
+// Carlo tree search, which copes better with the many moves of large boards.
+enum class SearchEngine {
+    AlphaBeta,
+    MonteCarlo
+};
+
+// Budget for one getBestMove() call. The search deepens one ply at a time
+// until any limit is hit and plays the best move of the last completed depth.
+// With several threads the node budget applies to each thread separately.
+// The Monte Carlo engine is single-threaded and counts playouts as nodes.
+//
+// Endgames with at most solveTiles tiles and solveClusters moves left are
+// solved exactly first, with either engine. The solver gets half of the time
+// and node budgets; if it can't finish, the engine has the rest.
+struct SearchLimits {
+    int timeMs = 500;        // wall-clock budget, 0 = unlimited
+    long long maxNodes = 0;  // search nodes, 0 = unlimited
+    int maxDepth = 64;
+    int threads = 1;         // Lazy SMP search threads; 1 is deterministic
+    SearchEngine engine = SearchEngine::AlphaBeta;
+    int treeMB = 64;         // Monte Carlo tree memory cap
+    int solveTiles = 50;     // 0 = never solve
+    int solveClusters = 16;
+};
+
+// Everything makeMove changed, so unmakeMove can revert it in time
+// proportional to the move rather than to the board.
+struct MoveUndo {
+    long long points;                        // credited to the player who moved
+    char color;                              // of the removed cluster
+    int removed;                             // tiles removed
+
+    // Columns whose contents changed, numbered as after the move. Collapsing
+    // an empty column shifts everything right of it, so the range then runs
+    // to the old right edge of the board.
+    int firstChangedCol;
+    int lastChangedCol;
+    int collapsedCols;                       // empty columns removed
+
+    // Graph backend. Tiles below baseHeight in the cluster's columns didn't
+    // move; columnTiles holds those columns from baseHeight up to their old
+    // heights, as they were before the move.
+    uint64_t boardHash;
+    int baseHeight;
+    vector<char> columnTiles;
+    vector<int> emptiedCols;                 // in the numbering from before the move
+    int activeColsBefore;
+    vector<int> colHeights;                  // from firstChangedCol
+    BitBoard::Undo bits;                     // bitboard backend
+
+    // Evaluation terms before the move, for the columns it touched
+    int evalFirstCol;
+    int adjacencyBefore;
+    int isolatedBefore;
+    vector<int> colAdjacencyBefore;
+    vector<int> colIsolatedBefore;
+    // Graph backend: rows below evalLastRow didn't change unless columns
+    // collapsed, so the shares only need recounting over rows [0, evalLastRow]
+    int evalLastRow;
+    vector<int> rowsAdjacencyBefore;
+    vector<int> rowsIsolatedBefore;
+};
+
+// One ply's buffers in the alpha-beta search. A node's move list and undo
+// record must outlive the search of its children, so every ply has its own;
+// the vectors keep their capacity, so a ply the search has reached before
+// allocates nothing.
+struct PlyScratch {
+    vector<ClusterInfo> clusters;
+    vector<pair<int, int>> moveOrder;
+    MoveUndo undo;
 };
 
-// Transposition table entry with alpha-beta bounds
-struct TTEntry {
-    int value;
-    int depth;
-    int flag; // 0 = exact, 1 = lower bound, 2 = upper bound
+// A board in the endgame solver's table. What the side to move can still
+// gain over its opponent doesn't depend on whose turn it is or on the scores
+// so far, so entries are keyed by the tiles alone and outlive the search
+// that stored them.
+struct SolvedPosition {
+    uint64_t key;   // tileHash(), 0 for an empty slot
+    int lower;      // bounds on the value; equal once it is exact
+    int upper;
+    int bestMove;   // anchor cell (row * cols + col), -1 if unknown
+};
+
+// A buffer whose contents only matter to the game object that filled it.
+// Copies start empty, like ClusterCache, so copying a game for a search
+// thread costs its position and not its caches.
+template <class T>
+struct Scratch : T {
+    Scratch() = default;
+    Scratch(const Scratch&) : T() {}
+    Scratch& operator=(const Scratch&) { T::clear(); return *this; }
 };
 
 class SameGame {
 private:
-    vector<Node> nodes;
-    vector<vector<int>> nodeGrid;
+    // Graph backend: one color byte per cell, '\0' for empty. Cells are
+    // column-major from the bottom, cell = col * rows + rows - 1 - row, so a
+    // column's tiles are the first colHeight[col] cells of its run.
+    vector<char> tiles;
+    vector<int> colHeight;  // graph backend: tiles stacked in each column
+    int activeCols;         // graph backend: columns [activeCols, cols) are empty
     int rows;
     int cols;
-    int score;
+    long long score;        // (n - 2)^2 per cluster overflows int on big boards
     int moves;
     
     bool isUserTurn;
-    int userScore;
-    int computerScore;
+    long long userScore;
+    long long computerScore;
+
+    BoardBackend requestedBackend;
+    BoardBackend backend;
+    BitBoard bits;
+    uint64_t boardHash; // Zobrist hash of the graph backend's tiles
 
     vector<pair<int, int>> detectClusterBFS(int startRow, int startCol);
-    void applyGravity();
-    void buildGraph(const vector<vector<char>>& initialGrid);
-    int getNodeIndex(int row, int col) const;
-    void updateNeighbors();
+    // Graph backend flood fill into fillCells (empty for an empty cell).
+    // fillVisited has a bit per cell, cleared again after each fill.
+    Scratch<vector<int>> fillCells;
+    vector<uint64_t> fillVisited;
+    void floodFill(int row, int col);
+    void applyGravity(int firstCol, int lastCol, int bottomRow, MoveUndo& undo);
+    void loadTiles(const vector<vector<char>>& initialGrid);
+    int cellOf(int row, int col) const { return col * rows + rows - 1 - row; }
+    // Color at (row, col), '\0' for an empty or off-board cell
+    char tileAt(int row, int col) const;
+    uint64_t computeBoardHash() const;
+    uint64_t tileHash() const; // getHash() without the side to move
+
+    // Evaluation terms kept up to date by every move and unmove: each
+    // column's share of the same-color adjacency and isolated-tile counts,
+    // and whole-board tile totals. A move only changes the shares of the
+    // columns it touched and their neighbours.
+    vector<int> colAdjacency;
+    vector<int> colIsolated;
+    int adjacencyTotal;
+    int isolatedTotal;
+    int activeTotal;
+    array<int, 256> colorTotal; // by color character
+    void initEvalTerms();
+    void recordEvalRows(int firstCol, int lastCol, int lastRow, MoveUndo& undo);
+    void updateEvalTerms(MoveUndo& undo);
+    void restoreEvalTerms(const MoveUndo& undo);
+    // Counted over the column's rows up to lastRow (the bitboard backend
+    // always counts whole columns)
+    int columnAdjacencies(int col, int lastRow) const;
+    int columnIsolated(int col, int lastRow) const;
+#ifdef SAMEGAME_DEBUG_HASH
+    void verifyEvalTerms() const;
+#endif
+
+    // Connected-component labelling scratch for the graph backend
+    Scratch<vector<int>> ccParent;
+    Scratch<vector<int>> ccSlot;
+    Scratch<vector<ClusterInfo>> clusterInfo;
+    void collectClusters(vector<ClusterInfo>& out);
+    void collectMoves(vector<tuple<int, char, int, int>>& out);
+    void labelClusters(vector<ClusterInfo>& out);
+    void linkClusters(const char* grid, int linkedCols);
+    int findRoot(int cell);
+
+    // --- Exact endgame solver ---
+    // Open addressing with no replacement: a position that finds no free
+    // slot near its home is simply not stored. Shared with copies like
+    // transTable, so only one of them may solve at a time; filled by
+    // reserveSearchScratch() and replaced by reset().
+    static const int SOLVED_TABLE_SIZE = 1 << 18;
+    static const int SOLVED_PROBES = 4;
+    shared_ptr<vector<SolvedPosition>> solvedTable;
+    Scratch<vector<char>> solveColors; // colors on the board when the solve started
+    int solveMaxPly;
+    int solvedRootMove;        // best move of the last solve, row * cols + col
+    bool lastSolved;
+    long long provenLead;
+    bool solveEndgame(pair<int, int>& move);
+    int solve(int ply, int alpha, int beta);
+    int remainingPointsBound() const;
+    SolvedPosition* findSolved(uint64_t key);
+
+    // getClusterLabels() state, valid while tileHash() == labelsHash. The
+    // labels reuse the union-find scratch above; labelGrid holds the
+    // bitboard's tiles in the graph's layout.
+    Scratch<vector<int>> cellLabels;
+    Scratch<vector<int>> labelSizes;
+    Scratch<vector<char>> labelGrid;
+    uint64_t labelsHash;
 
     // --- AI Engine ---
-    unordered_map<string, TTEntry> transTable;
+    // Kept across turns and shared with the copies used by search threads;
+    // reset() starts a fresh one.
+    shared_ptr<TranspositionTable> transTable;
+    shared_ptr<MonteCarloTree> searchTree; // same sharing rules as transTable
+    ClusterCache clusterCache; // per game copy, emptied by reset()
+    bool cachedClusters(uint64_t tiles, ClusterList& out);
+    ClusterList generateClusters(uint64_t tiles);
+#ifdef SAMEGAME_DEBUG_HASH
     string boardStateKey();
+    int hashCollisions;
+#endif
     
-    // Alpha-beta minimax
+    // Alpha-beta minimax; WithStats also fills in *stats
+    template <bool WithStats>
     int alphaBeta(int depth, int alpha, int beta);
+    pair<int, int> searchBestMove();
+
+    // Iterative deepening state
+    SearchLimits limits;
+    chrono::steady_clock::time_point searchDeadline;
+    long long searchNodes;
+    bool searchAborted;
+    bool horizonReached;   // some line was cut off by depth, not game end
+    int lastSearchDepth;
+    int rootDepth;         // depth of the iteration in progress
+    const atomic<bool>* stopSignal; // set by the main thread to stop helpers
+    SearchStats* stats;
+    int clockInterval;     // nodes between clock reads, a power of two
+    bool outOfBudget();
+    // Search buffers, kept between searches so that a warmed-up
+    // single-threaded getBestMove() allocates nothing
+    Scratch<vector<PlyScratch>> plyScratch; // by ply below the root
+    Scratch<vector<tuple<int, char, int, int>>> rootClusters;
+    Scratch<vector<pair<int, int>>> rootOrder;
+    Scratch<vector<pair<int, int>>> iterationOrder; // this thread's copy of rootOrder
+    Scratch<vector<int>> rootValues;
+    Scratch<vector<int>> rootPosition; // reorderRootMoves() tie-break
+    // Sets up the buffers and the table before the first node, so nothing
+    // grows in the middle of a line; part of the search's time budget
+    void reserveSearchScratch();
+    int iterativeDeepening(const vector<tuple<int, char, int, int>>& clusters,
+                           const vector<pair<int, int>>& moveOrder, int helper);
+    int searchIteration(const vector<tuple<int, char, int, int>>& clusters,
+                        const vector<pair<int, int>>& moveOrder, int depth,
+                        vector<int>& values);
+    void orderRootMoves(const vector<tuple<int, char, int, int>>& clusters,
+                        vector<pair<int, int>>& moveOrder);
+    void reorderRootMoves(vector<pair<int, int>>& moveOrder,
+                          const vector<int>& values, int best);
+    bool probeRoot(TTEntry& out);
     
-    // Strategic evaluation
-    int evaluateStrategic();
+    // Strategic evaluation of a position with the given move list
+    int evaluateStrategic(ClusterList clusters);
+    Scratch<vector<int>> clusterSizes; // evaluation scratch
+    friend class SameGameBench; // bench.cpp times the evaluation directly
     int countColorAdjacencies();
+    int countIsolatedTiles();
+    int countActiveTiles();
+    int countColorTiles(char color);
     
     // Move ordering heuristic
     int getSmartMoveHeuristic(int clusterSize, int row, int col, char color);
-    
-    struct BoardSnapshot {
-        vector<Node> nodes;
-        vector<vector<int>> nodeGrid;
-        int score, moves;
-        bool isUserTurn;
-        int userScore, computerScore;
-    };
-    BoardSnapshot saveState();
-    void restoreState(const BoardSnapshot& snap);
+
+    // Move ordering learned from cutoffs. Moves are named by their anchor
+    // cell (row * cols + col), which still names the same cluster in a
+    // sibling position as long as nothing near it fell.
+    static const int HISTORY_SIZE = 4096;
+    vector<array<int, 2>> killers;   // killerKey()s per ply, -1 if empty
+    array<int, HISTORY_SIZE> history; // by (color, anchor), hashed
+    static int killerKey(char color, int cell);
+    int historyIndex(char color, int cell) const;
+    void ageMoveOrdering();
+    void recordCutoff(int ply, int depth, const ClusterInfo& move);
     
 public:
-    SameGame(const vector<vector<char>>& initialGrid);
+    SameGame(const vector<vector<char>>& initialGrid,
+             BoardBackend backend = BoardBackend::Auto);
     int getRows() const { return rows; }
     int getCols() const { return cols; }
-    int getScore() const { return score; }
+    long long getScore() const { return score; }
     int getMoves() const { return moves; }
     char getTile(int row, int col) const;
     bool isTileActive(int row, int col) const;
     bool getUserTurn() const { return isUserTurn; }
-    int getUserScore() const { return userScore; }
-    int getComputerScore() const { return computerScore; }
+    long long getUserScore() const { return userScore; }
+    long long getComputerScore() const { return computerScore; }
+    BoardBackend getBackend() const { return backend; }
+    // Zobrist hash of the position, including the side to move
+    uint64_t getHash() const;
+    void setTranspositionTableSize(size_t megabytes) { transTable->resize(megabytes); }
+#ifdef SAMEGAME_DEBUG_HASH
+    int getHashCollisions() const { return hashCollisions; }
+#endif
     
     vector<pair<int, int>> getCluster(int row, int col);
     int getClusterSize(int row, int col);
+    // Cluster label of every cell, row-major (row * cols + col), -1 for
+    // empty cells; two tiles are in the same cluster when their labels are
+    // equal. Computed once per position and reused until the board changes.
+    const vector<int>& getClusterLabels();
+    // Tiles in the cluster with that label in the last getClusterLabels(),
+    // 0 for -1
+    int getLabelSize(int label) const {
+        return label >= 0 && label < (int)labelSizes.size() ? labelSizes[label] : 0;
+    }
     bool removeCluster(int row, int col);
+    // Same as removeCluster, recording what changed into `undo`
+    bool makeMove(int row, int col, MoveUndo& undo);
+    void unmakeMove(const MoveUndo& undo);
     bool hasMovesLeft();
     void reset(const vector<vector<char>>& initialGrid);
     void switchTurn() { isUserTurn = !isUserTurn; }
     
     vector<tuple<int, char, int, int>> getAllClusters();
+    // Every cluster of two or more tiles, with bounding boxes
+    vector<ClusterInfo> getClusterInfo();
     
+    // Best move for the side to move; the computer maximizes its lead and
+    // the user minimizes it
     pair<int, int> getBestMove();
+    void setSearchLimits(const SearchLimits& newLimits) { limits = newLimits; }
+    const SearchLimits& getSearchLimits() const { return limits; }
+    // Depth of the last fully searched iteration of getBestMove(), counting
+    // a deeper result left in the table by pondering
+    int getLastSearchDepth() const { return lastSearchDepth; }
+    // alphaBeta and endgame solver nodes visited by this thread during the
+    // last search, plus the playouts of the Monte Carlo engine; the same
+    // count as SearchStats::nodes
+    long long getLastSearchNodes() const { return searchNodes; }
+    // Whether the last getBestMove() solved the endgame exactly, and if so
+    // the final computer score minus user score with best play on both sides
+    bool getLastSearchSolved() const { return lastSolved; }
+    long long getProvenLead() const { return provenLead; }
+    // On the user's turn, searches the computer's answers to the `replies`
+    // likeliest user moves until the stop signal or the search limits end
+    // it. Results stay in the transposition table, which copies share, so
+    // getBestMove() after the user's move starts from them. Single-threaded;
+    // the node budget covers the whole ponder.
+    void ponder(int replies = 4);
+    // Nodes kept in the Monte Carlo tree for reuse by the next search
+    size_t getSearchTreeSize() const;
+    // getBestMove() gives up as soon as *signal becomes true, e.g. when the
+    // GUI cancels a background search; pass nullptr to detach.
+    void setStopSignal(const atomic<bool>* signal) { stopSignal = signal; }
+    // Each getBestMove() overwrites *stats with what it did; nullptr (the
+    // default) turns the instrumentation off.
+    void setSearchStats(SearchStats* searchStats) { stats = searchStats; }
 };
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef SEARCHSTATS_H
+#define SEARCHSTATS_H
+
+#include <array>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+// What one getBestMove() call did, filled in only while a SearchStats is
+// attached with SameGame::setSearchStats(). The instrumented alpha-beta is a
+// separate template instantiation, so searches without stats run none of
+// this code. With several search threads only the main thread is counted.
+struct SearchStats {
+    static const int CUTOFF_SLOTS = 8;
+
+    long long nodes = 0;            // alphaBeta calls (Monte Carlo: playouts),
+                                    // plus endgame solver calls
+    long long leafEvaluations = 0;  // evaluateStrategic() at the horizon
+    long long terminalNodes = 0;    // positions with no moves left
+    long long ttProbes = 0;
+    long long ttHits = 0;
+    long long ttCutoffs = 0;        // answered straight from the table
+    long long clusterCacheLookups = 0;
+    long long clusterCacheHits = 0; // move lists reused, not regenerated
+    // Beta cutoffs by the position of the cutting move in the ordered move
+    // list; the last slot also counts every later position
+    array<long long, CUTOFF_SLOTS> betaCutoffs = {};
+    int completedDepth = 0;         // last full iteration
+    bool solved = false;            // the endgame solver proved the result
+    int maxPly = 0;                 // deepest ply reached
+
+    chrono::nanoseconds moveGenTime{0};     // cluster generation and ordering
+    chrono::nanoseconds evalTime{0};        // leaf and terminal evaluation
+    chrono::nanoseconds makeUnmakeTime{0};  // makeMove + unmakeMove
+    chrono::nanoseconds totalTime{0};
+
+    void reset() { *this = SearchStats(); }
+
+    long long totalBetaCutoffs() const {
+        long long total = 0;
+        for (long long count : betaCutoffs) total += count;
+        return total;
+    }
+
+    // Share of cutoffs produced by the first move tried
+    double firstMoveCutoffRate() const {
+        long long total = totalBetaCutoffs();
+        return total ? (double)betaCutoffs[0] / total : 0;
+    }
+
+    // nodes^(1 / depth): the average number of children searched per node
+    double effectiveBranchingFactor() const {
+        return completedDepth > 0 ? pow((double)nodes, 1.0 / completedDepth) : 0;
+    }
+};
+
+#endif
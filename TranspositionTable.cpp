@@ -0,0 +1,121 @@
+#include "TranspositionTable.h"
+
+namespace {
+
+uint64_t packData(const TTEntry &e) {
+  return (uint64_t)(uint32_t)e.value | ((uint64_t)(uint32_t)e.bestMove << 32);
+}
+
+uint64_t packMeta(const TTEntry &e, uint8_t gen) {
+  return (uint64_t)(uint16_t)e.depth | ((uint64_t)e.flag << 16) |
+         ((uint64_t)gen << 24);
+}
+
+} // namespace
+
+TranspositionTable::TranspositionTable(size_t megabytes)
+    : bucketCount(0), mask(0), generation(0) {
+  resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+  budgetBytes = megabytes * 1024 * 1024;
+  buckets.reset();
+  bucketCount = 0;
+  mask = 0;
+}
+
+void TranspositionTable::allocate() {
+  // Largest power of two number of buckets that fits in the budget
+  size_t count = 1;
+  while (count * 2 * sizeof(Bucket) <= budgetBytes) {
+    count *= 2;
+  }
+  buckets.reset(new Bucket[count]);
+  bucketCount = count;
+  mask = count - 1;
+  clear();
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i < 2 * bucketCount; i++) {
+    Slot &slot = i % 2 ? buckets[i / 2].recent : buckets[i / 2].deep;
+    // Empty slots have depth -1, so they read as a miss for every key
+    slot.check.store(0, memory_order_relaxed);
+    slot.data.store(0, memory_order_relaxed);
+    slot.meta.store(0xFFFF, memory_order_relaxed);
+#ifdef SAMEGAME_DEBUG_HASH
+    slot.boardCheck.store(0, memory_order_relaxed);
+#endif
+  }
+  generation.store(0, memory_order_relaxed);
+}
+
+void TranspositionTable::reserve() {
+  if (!buckets) {
+    allocate();
+  }
+}
+
+void TranspositionTable::newSearch() {
+  reserve();
+  generation.fetch_add(1, memory_order_relaxed);
+}
+
+bool TranspositionTable::read(const Slot &slot, uint64_t key, TTEntry &out) {
+  uint64_t check = slot.check.load(memory_order_relaxed);
+  uint64_t data = slot.data.load(memory_order_relaxed);
+  uint64_t meta = slot.meta.load(memory_order_relaxed);
+  if ((check ^ data ^ meta) != key)
+    return false;
+
+  out.key = key;
+  out.value = (int32_t)(uint32_t)data;
+  out.bestMove = (int32_t)(uint32_t)(data >> 32);
+  out.depth = (int16_t)(uint16_t)meta;
+  out.flag = (uint8_t)(meta >> 16);
+  out.generation = (uint8_t)(meta >> 24);
+#ifdef SAMEGAME_DEBUG_HASH
+  out.boardCheck = slot.boardCheck.load(memory_order_relaxed);
+#endif
+  return out.depth >= 0;
+}
+
+void TranspositionTable::write(Slot &slot, const TTEntry &entry, uint8_t gen) {
+  uint64_t data = packData(entry);
+  uint64_t meta = packMeta(entry, gen);
+  slot.data.store(data, memory_order_relaxed);
+  slot.meta.store(meta, memory_order_relaxed);
+  slot.check.store(entry.key ^ data ^ meta, memory_order_relaxed);
+#ifdef SAMEGAME_DEBUG_HASH
+  slot.boardCheck.store(entry.boardCheck, memory_order_relaxed);
+#endif
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &out) const {
+  if (!buckets)
+    return false;
+
+  const Bucket &bucket = buckets[key & mask];
+  return read(bucket.deep, key, out) || read(bucket.recent, key, out);
+}
+
+void TranspositionTable::store(const TTEntry &entry) {
+  if (!buckets)
+    return;
+
+  Bucket &bucket = buckets[entry.key & mask];
+  uint8_t gen = generation.load(memory_order_relaxed);
+
+  // The depth-preferred slot takes the new result if it is empty, left over
+  // from an earlier search, or no deeper than what we are storing now.
+  uint64_t meta = bucket.deep.meta.load(memory_order_relaxed);
+  int16_t deepDepth = (int16_t)(uint16_t)meta;
+  uint8_t deepGen = (uint8_t)(meta >> 24);
+  if (deepDepth < 0 || deepGen != gen || entry.depth >= deepDepth) {
+    write(bucket.deep, entry, gen);
+    return;
+  }
+
+  write(bucket.recent, entry, gen);
+}
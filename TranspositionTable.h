@@ -0,0 +1,82 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Transposition table entry with alpha-beta bounds
+struct TTEntry {
+    uint64_t key;
+    int value;
+    int bestMove;       // row * cols + col of the best cluster, -1 if unknown
+    int16_t depth;      // -1 marks an empty slot
+    uint8_t flag;       // 0 = exact, 1 = lower bound, 2 = upper bound
+    uint8_t generation; // search that last wrote the entry
+#ifdef SAMEGAME_DEBUG_HASH
+    uint64_t boardCheck; // independent fingerprint, to detect hash collisions
+#endif
+};
+
+// Fixed-size, power-of-two bucketed transposition table.
+//
+// Each bucket holds a depth-preferred slot, which keeps the deepest result
+// seen for the current search, and an always-replace slot for everything
+// else. Entries are tagged with the search generation so stale results from
+// earlier turns are the first to be overwritten while still being usable.
+//
+// The table can be shared by several search threads without locks: a slot is
+// a few relaxed atomic words, and the stored key is XORed with the data, so an
+// entry torn by a concurrent write fails the key check and reads as a miss.
+class TranspositionTable {
+private:
+    struct Slot {
+        atomic<uint64_t> check; // key ^ data ^ meta
+        atomic<uint64_t> data;  // value, best move
+        atomic<uint64_t> meta;  // depth, flag, generation
+#ifdef SAMEGAME_DEBUG_HASH
+        atomic<uint64_t> boardCheck;
+#endif
+    };
+    struct Bucket {
+        Slot deep;
+        Slot recent;
+    };
+
+    unique_ptr<Bucket[]> buckets;
+    size_t bucketCount;
+    size_t budgetBytes;
+    uint64_t mask;
+    atomic<uint8_t> generation;
+
+    void allocate();
+    static bool read(const Slot& slot, uint64_t key, TTEntry& out);
+    static void write(Slot& slot, const TTEntry& entry, uint8_t gen);
+
+public:
+    static const size_t DEFAULT_MB = 16;
+
+    explicit TranspositionTable(size_t megabytes = DEFAULT_MB);
+
+    // Memory is reserved lazily on the first search after a resize.
+    // Neither resize nor clear may run while a search is using the table.
+    void resize(size_t megabytes);
+    void clear();
+    // Allocates the table now if it is still waiting for its first search
+    void reserve();
+    void newSearch();
+
+    // Copies the entry for `key` into `out`; false on a miss.
+    bool probe(uint64_t key, TTEntry& out) const;
+    void store(const TTEntry& entry);
+
+    size_t capacity() const { return bucketCount * 2; }
+    size_t budget() const { return budgetBytes; }
+    size_t budgetMegabytes() const { return budgetBytes / (1024 * 1024); }
+    uint8_t currentGeneration() const { return generation.load(memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+// Zobrist keys for board positions.
+//
+// Keys are derived on demand by mixing (row, col, color) rather than read from
+// a table, so they cost no memory on large boards, copies of a game share
+// them for free, and every board backend produces identical hashes.
+namespace zobrist {
+
+inline uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t tileKey(int row, int col, char color) {
+    return mix(((uint64_t)(uint32_t)row << 32) ^ ((uint64_t)(uint32_t)col << 8) ^
+               (unsigned char)color);
+}
+
+// XORed in while it is the computer's turn
+const uint64_t SIDE_KEY = 0xD1B54A32D192ED03ULL;
+
+} // namespace zobrist
+
+#endif
@@ -0,0 +1,244 @@
+// Microbenchmarks for the board operations and the search.
+//
+//   bench [--json] [--min-ms M] [--filter SUBSTRING]
+//
+// Every case runs on fixed-seed boards (6x8, 10x10, 15x15, 30x30) with both
+// board backends and reports ns/op and heap allocations/op; the search
+// cases also report nodes/sec. --json prints one machine-readable document
+// for comparing runs instead of the table.
+#include "SameGame.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+// --- Allocation counting ---
+static atomic<long long> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Private hooks the benchmarks need
+class SameGameBench {
+public:
+    // Includes generating the move list, as on a cache miss
+    static int evaluate(SameGame& game) {
+        game.collectClusters(game.clusterInfo);
+        return game.evaluateStrategic(game.clusterInfo);
+    }
+    // Forgets everything earlier searches learned, keeping the memory, so
+    // the next search does the same work as the first
+    static void clearTables(SameGame& game) {
+        game.transTable->clear();
+        game.clusterCache.clear();
+        fill(game.solvedTable->begin(), game.solvedTable->end(), SolvedPosition{0, 0, 0, -1});
+        game.history.fill(0);
+    }
+};
+
+struct Result {
+    string board;
+    string backend;
+    string op;
+    long long iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double nodesPerSec;  // 0 when not a search
+};
+
+static volatile long long sink;
+
+vector<vector<char>> makeGrid(int rows, int cols, uint64_t seed) {
+    static const char COLORS[] = {'G', 'W', 'R', 'B', 'Y'};
+    vector<vector<char>> grid(rows, vector<char>(cols));
+    for (auto& row : grid) {
+        for (char& tile : row) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            tile = COLORS[(seed >> 33) % 5];
+        }
+    }
+    return grid;
+}
+
+// Runs `op` until `minMs` has passed (and at least a few times), timing the
+// whole batch so the clock read is amortized. `op` returns nodes searched.
+Result measure(const string& op, int minMs, const function<long long()>& body) {
+    Result r = {"", "", op, 0, 0, 0, 0};
+    long long nodes = 0;
+    long long allocsBefore = allocations.load();
+    auto start = chrono::steady_clock::now();
+    auto deadline = start + chrono::milliseconds(minMs);
+    long long batch = 1;
+    while (true) {
+        for (long long i = 0; i < batch; i++) nodes += body();
+        r.iterations += batch;
+        if (r.iterations >= 3 && chrono::steady_clock::now() >= deadline) break;
+        batch = min(batch * 2, 1LL << 16);
+    }
+    double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    r.nsPerOp = ns / r.iterations;
+    r.allocsPerOp = (double)(allocations.load() - allocsBefore) / r.iterations;
+    r.nodesPerSec = nodes ? nodes / (ns * 1e-9) : 0;
+    return r;
+}
+
+void benchBoard(int rows, int cols, BoardBackend backend, int minMs,
+                const string& filter, vector<Result>& out) {
+    vector<vector<char>> grid = makeGrid(rows, cols, 42 + rows * 1000 + cols);
+    SameGame game(grid, backend);
+    vector<tuple<int, char, int, int>> clusters = game.getAllClusters();
+    string board = to_string(rows) + "x" + to_string(cols);
+    string backendName = game.getBackend() == BoardBackend::BitBoard ? "bitboard" : "graph";
+
+    auto selected = [&](const string& op) {
+        return filter.empty() || (board + " " + backendName + " " + op).find(filter) != string::npos;
+    };
+    auto run = [&](const string& op, const function<long long()>& body) {
+        if (!selected(op)) return;
+        Result r = measure(op, minMs, body);
+        r.board = board;
+        r.backend = backendName;
+        out.push_back(r);
+    };
+
+    // Cluster detection from every cell in turn
+    int cell = 0;
+    run("getCluster", [&] {
+        int r = cell / cols, c = cell % cols;
+        cell = (cell + 1) % (rows * cols);
+        sink = sink + game.getCluster(r, c).size();
+        return 0LL;
+    });
+    run("getAllClusters", [&] {
+        sink = sink + game.getAllClusters().size();
+        return 0LL;
+    });
+    run("getClusterInfo", [&] {
+        sink = sink + game.getClusterInfo().size();
+        return 0LL;
+    });
+    run("hasMovesLeft", [&] {
+        sink = sink + game.hasMovesLeft();
+        return 0LL;
+    });
+    run("evaluateStrategic", [&] {
+        sink = sink + SameGameBench::evaluate(game);
+        return 0LL;
+    });
+
+    // A removal with gravity and its exact undo, cycling through the moves
+    MoveUndo undo;
+    size_t next = 0;
+    run("makeMove+unmakeMove", [&] {
+        const auto& cluster = clusters[next];
+        next = (next + 1) % clusters.size();
+        game.makeMove(get<2>(cluster), get<3>(cluster), undo);
+        game.unmakeMove(undo);
+        return 0LL;
+    });
+
+    // The searches reuse one game, warmed up by a first search so that its
+    // tables and buffers exist, and clear its tables before every run
+    auto timedSearch = [&](const string& op, const SearchLimits& limits) {
+        if (!selected(op)) return;
+        SameGame search(grid, backend);
+        search.setTranspositionTableSize(1);
+        search.setSearchLimits(limits);
+        search.switchTurn();
+        search.getBestMove();
+        run(op, [&] {
+            SameGameBench::clearTables(search);
+            pair<int, int> move = search.getBestMove();
+            sink = sink + move.first + search.getProvenLead();
+            return search.getLastSearchNodes();
+        });
+    };
+
+    // Fixed-depth search from an empty 1 MB table
+    int depth = rows * cols <= 100 ? 4 : 2;
+    SearchLimits fixed;
+    fixed.timeMs = 0;
+    fixed.maxDepth = depth;
+    fixed.solveTiles = 0;
+    timedSearch("getBestMove(depth " + to_string(depth) + ")", fixed);
+
+    // Whole game solved exactly, on boards small enough for the solver
+    SearchLimits exact;
+    exact.timeMs = 0;
+    exact.solveClusters = INT_MAX;
+    if (rows * cols <= exact.solveTiles) timedSearch("getBestMove(solve)", exact);
+}
+
+string jsonEscape(const string& s) {
+    string out;
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    int minMs = 200;
+    string filter;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json") json = true;
+        else if (arg == "--min-ms" && i + 1 < argc) minMs = atoi(argv[++i]);
+        else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else {
+            cerr << "Usage: bench [--json] [--min-ms M] [--filter SUBSTRING]" << endl;
+            return 1;
+        }
+    }
+
+    const int SIZES[][2] = {{6, 8}, {10, 10}, {15, 15}, {30, 30}};
+    vector<Result> results;
+    for (const auto& size : SIZES) {
+        for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+            benchBoard(size[0], size[1], backend, minMs, filter, results);
+        }
+    }
+
+    if (json) {
+        cout << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            cout << "    {\"board\": \"" << r.board << "\", \"backend\": \"" << r.backend
+                 << "\", \"op\": \"" << jsonEscape(r.op) << "\", \"iterations\": " << r.iterations
+                 << fixed << setprecision(2)
+                 << ", \"ns_per_op\": " << r.nsPerOp << ", \"allocs_per_op\": " << r.allocsPerOp
+                 << ", \"nodes_per_sec\": " << setprecision(0) << r.nodesPerSec << "}"
+                 << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        cout << "  ]\n}" << endl;
+        return 0;
+    }
+
+    cout << left << setw(8) << "board" << setw(10) << "backend" << setw(24) << "op"
+         << right << setw(14) << "ns/op" << setw(12) << "allocs/op" << setw(14) << "nodes/sec" << endl;
+    for (const Result& r : results) {
+        cout << left << setw(8) << r.board << setw(10) << r.backend << setw(24) << r.op
+             << right << fixed << setprecision(1) << setw(14) << r.nsPerOp
+             << setw(12) << r.allocsPerOp << setprecision(0) << setw(14);
+        if (r.nodesPerSec > 0) cout << r.nodesPerSec; else cout << "-";
+        cout << endl;
+    }
+    return 0;
+}
@@ -6,7 +6,7 @@ echo Building Same Game...
 REM Set PATH to use MSYS2 mingw64 first
 set "PATH=C:\msys64\mingw64\bin;%PATH%"
 
-g++.exe -std=c++17 -IC:\msys64\mingw64\include -I. SameGame.cpp main.cpp -o SameGame.exe -LC:\msys64\mingw64\lib -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf
+g++.exe -std=c++17 -pthread -IC:\msys64\mingw64\include -I. SameGame.cpp BitBoard.cpp TranspositionTable.cpp ClusterCache.cpp MonteCarloTree.cpp main.cpp -o SameGame.exe -LC:\msys64\mingw64\lib -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf
 
 if %ERRORLEVEL% EQU 0 (
     echo Build successful!
@@ -5,10 +5,10 @@
 export PATH="/c/msys64/mingw64/bin:$PATH"
 
 # Build the project
-g++ -std=c++17 \
+g++ -std=c++17 -pthread \
     -I/c/msys64/mingw64/include \
     -I. \
-    SameGame.cpp main.cpp \
+    SameGame.cpp BitBoard.cpp TranspositionTable.cpp ClusterCache.cpp MonteCarloTree.cpp main.cpp \
     -o SameGame.exe \
     -L/c/msys64/mingw64/lib \
     -lmingw32 -lSDL2main -lSDL2 -lSDL2_ttf
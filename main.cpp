@@ -4,6 +4,10 @@
 #include <iostream>
 #include <string>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <list>
+#include <unordered_map>
 
 using namespace std;
 
@@ -25,10 +29,18 @@ vector<vector<char>> generateRandomGrid(int rows, int cols) {
 
 const int WINDOW_WIDTH = 750;
 const int WINDOW_HEIGHT = 650;
-const int TILE_SIZE = 80;
+const int TILE_SIZE = 80;       // largest zoom
+const int MIN_TILE_SIZE = 2;    // smallest zoom
 const int GRID_OFFSET_X = 80;
 const int GRID_OFFSET_Y = 140;
+const int VIEW_WIDTH = 640;     // the board is drawn into this viewport
+const int VIEW_HEIGHT = 480;
+const int SCROLL_STEP = 40;     // pixels per arrow key press
+const int DEFAULT_ROWS = 6;
+const int DEFAULT_COLS = 8;
 const int UI_HEIGHT = 120;
+const Uint32 FRAME_MS = 16;  // ~60 FPS
+const size_t TEXT_CACHE_SIZE = 32;  // rendered labels kept as textures
 
 class SameGameGUI {
 private:
@@ -38,9 +50,16 @@ private:
     SameGame* game;
     
     // Mouse state
+    int mouseX;
+    int mouseY;
     int hoveredRow;
     int hoveredCol;
-    vector<pair<int, int>> hoveredCluster;
+    
+    // Viewport: boards bigger than the view scroll and zoom. viewX and
+    // viewY are the board pixel at the viewport's top-left corner.
+    int tileSize;
+    int viewX;
+    int viewY;
     
     // Game state
     bool gameOver;
@@ -50,6 +69,33 @@ private:
     Uint32 lastComputerMoveTime;
     const Uint32 COMPUTER_MOVE_DELAY = 3000;  // 3 second delay for computer move
     
+    // Background search. The worker searches a copy of the board and posts
+    // aiMoveEvent when done, so the event loop never waits for the engine.
+    thread aiThread;
+    atomic<bool> aiCancel;
+    bool aiSearching;
+    bool aiMoveReady;
+    pair<int, int> aiMove;
+    Uint32 aiMoveEvent;
+    
+    // Pondering during the user's turn fills the transposition table that
+    // the next computer search starts from
+    thread ponderThread;
+    atomic<bool> ponderCancel;
+    bool pondering;
+    
+    // Rendered labels, most recently drawn first. A label is rasterized
+    // once and redrawn from its texture until its text changes or it falls
+    // off the end of the list.
+    struct TextTexture {
+        string key;
+        SDL_Texture* texture;
+        int width;
+        int height;
+    };
+    list<TextTexture> textCache;
+    unordered_map<string, list<TextTexture>::iterator> textIndex;
+    
     // Colors
     SDL_Color getColorForTile(char tile) {
         switch(tile) {
@@ -62,58 +108,71 @@ private:
         }
     }
     
+    // Label of the cluster under the mouse in game->getClusterLabels(), -1
+    // if there is none. Looked up each frame, so it follows the board when
+    // a move changes it.
+    int hoveredLabel() {
+        if (hoveredRow < 0 || hoveredCol < 0) return -1;
+        return game->getClusterLabels()[hoveredRow * game->getCols() + hoveredCol];
+    }
+    
     void drawTile(int row, int col, bool highlight = false) {
         if (!game->isTileActive(row, col)) return;
         
-        int x = GRID_OFFSET_X + col * TILE_SIZE;
-        int y = GRID_OFFSET_Y + row * TILE_SIZE;
+        int x = GRID_OFFSET_X + col * tileSize - viewX;
+        int y = GRID_OFFSET_Y + row * tileSize - viewY;
         
         SDL_Color color = getColorForTile(game->getTile(row, col));
         
-        // Draw tile background
-        SDL_Rect tileRect = {x + 2, y + 2, TILE_SIZE - 4, TILE_SIZE - 4};
+        // Draw tile background; tiny tiles have no room for a border
+        int inset = tileSize >= 8 ? 2 : 0;
+        SDL_Rect tileRect = {x + inset, y + inset, tileSize - 2 * inset, tileSize - 2 * inset};
         SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
         SDL_RenderFillRect(renderer, &tileRect);
         
         // Draw highlight border if needed
         if (highlight) {
             SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-            for(int i = 0; i < 4; i++) {
-                SDL_Rect borderRect = {x + i, y + i, TILE_SIZE - 2*i, TILE_SIZE - 2*i};
+            int width = max(1, min(4, tileSize / 8));
+            for(int i = 0; i < width; i++) {
+                SDL_Rect borderRect = {x + i, y + i, tileSize - 2*i, tileSize - 2*i};
                 SDL_RenderDrawRect(renderer, &borderRect);
             }
-        } else {
+        } else if (inset > 0) {
             // Draw normal border
             SDL_SetRenderDrawColor(renderer, 64, 64, 64, 255);
-            SDL_Rect borderRect = {x, y, TILE_SIZE, TILE_SIZE};
+            SDL_Rect borderRect = {x, y, tileSize, tileSize};
             SDL_RenderDrawRect(renderer, &borderRect);
         }
     }
     
+    // Draws only the tiles inside the viewport, so the cost of a frame
+    // depends on the zoom rather than on the size of the board
     void drawGrid() {
         // Draw background
         SDL_SetRenderDrawColor(renderer, 40, 40, 40, 255);
         SDL_Rect bgRect = {GRID_OFFSET_X - 5, GRID_OFFSET_Y - 5, 
-                          game->getCols() * TILE_SIZE + 10, 
-                          game->getRows() * TILE_SIZE + 10};
+                          min(game->getCols() * tileSize, VIEW_WIDTH) + 10, 
+                          min(game->getRows() * tileSize, VIEW_HEIGHT) + 10};
         SDL_RenderFillRect(renderer, &bgRect);
         
-        // Draw tiles
-        for (int i = 0; i < game->getRows(); i++) {
-            for (int j = 0; j < game->getCols(); j++) {
-                bool highlight = false;
-                
-                // Check if this tile is in the hovered cluster
-                for (const auto& tile : hoveredCluster) {
-                    if (tile.first == i && tile.second == j) {
-                        highlight = true;
-                        break;
-                    }
-                }
-                
-                drawTile(i, j, highlight);
+        SDL_Rect viewRect = {GRID_OFFSET_X, GRID_OFFSET_Y, VIEW_WIDTH, VIEW_HEIGHT};
+        SDL_RenderSetClipRect(renderer, &viewRect);
+        
+        // Draw tiles, highlighting the hovered cluster
+        const vector<int>& labels = game->getClusterLabels();
+        int hovered = hoveredLabel();
+        int firstRow = viewY / tileSize;
+        int lastRow = min(game->getRows() - 1, (viewY + VIEW_HEIGHT - 1) / tileSize);
+        int firstCol = viewX / tileSize;
+        int lastCol = min(game->getCols() - 1, (viewX + VIEW_WIDTH - 1) / tileSize);
+        for (int i = firstRow; i <= lastRow; i++) {
+            for (int j = firstCol; j <= lastCol; j++) {
+                drawTile(i, j, hovered >= 0 && labels[i * game->getCols() + j] == hovered);
             }
         }
+        
+        SDL_RenderSetClipRect(renderer, nullptr);
     }
     
     void drawUI() {
@@ -135,16 +194,17 @@ private:
         renderText(movesText, 300, 50, {200, 200, 200, 255});
         
         // Draw cluster size if hovering
-        if (!hoveredCluster.empty() && hoveredCluster.size() >= 2) {
-            int clusterSize = hoveredCluster.size();
-            int points = (clusterSize - 2) * (clusterSize - 2);
+        long long clusterSize = game->getLabelSize(hoveredLabel());
+        if (clusterSize >= 2) {
+            long long points = (clusterSize - 2) * (clusterSize - 2);
             string clusterText = "Cluster: " + to_string(clusterSize) + " tiles (" + to_string(points) + " pts)";
             renderText(clusterText, 250, 20, {255, 255, 0, 255});
         }
         
         // Show "Thinking..." when computer is about to move
         if (!gameOver && !game->getUserTurn()) {
-            renderText("Thinking...", 250, 50, {255, 200, 100, 255});
+            int dots = 1 + (SDL_GetTicks() / 300) % 3;
+            renderText("Thinking" + string(dots, '.'), 250, 50, {255, 200, 100, 255});
         }
         
         // Draw game over message
@@ -167,25 +227,64 @@ private:
     void renderText(const string& text, int x, int y, SDL_Color color, bool large = false) {
         if (!font) return;
         
-        SDL_Surface* surface = TTF_RenderText_Solid(font, text.c_str(), color);
-        if (!surface) return;
+        const TextTexture* cached = cachedText(text, color, large);
+        if (!cached) return;
         
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-        if (!texture) {
-            SDL_FreeSurface(surface);
-            return;
+        SDL_Rect destRect = {x, y, cached->width, cached->height};
+        SDL_RenderCopy(renderer, cached->texture, nullptr, &destRect);
+    }
+    
+    // The texture for `text`, rasterized on first use. Returns nullptr if
+    // SDL_ttf or the renderer fails.
+    const TextTexture* cachedText(const string& text, SDL_Color color, bool large) {
+        string key = text;
+        key += '\0';
+        key += (char)color.r;
+        key += (char)color.g;
+        key += (char)color.b;
+        key += (char)color.a;
+        key += large ? 'L' : 'S';
+        
+        auto found = textIndex.find(key);
+        if (found != textIndex.end()) {
+            textCache.splice(textCache.begin(), textCache, found->second);
+            return &textCache.front();
         }
         
-        SDL_Rect destRect = {x, y, surface->w, surface->h};
-        SDL_RenderCopy(renderer, texture, nullptr, &destRect);
+        SDL_Surface* surface = TTF_RenderText_Solid(font, text.c_str(), color);
+        if (!surface) return nullptr;
         
-        SDL_DestroyTexture(texture);
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+        int width = surface->w;
+        int height = surface->h;
         SDL_FreeSurface(surface);
+        if (!texture) return nullptr;
+        
+        if (textCache.size() >= TEXT_CACHE_SIZE) {
+            SDL_DestroyTexture(textCache.back().texture);
+            textIndex.erase(textCache.back().key);
+            textCache.pop_back();
+        }
+        textCache.push_front({key, texture, width, height});
+        textIndex[key] = textCache.begin();
+        return &textCache.front();
+    }
+    
+    void clearTextCache() {
+        for (const auto& entry : textCache) {
+            SDL_DestroyTexture(entry.texture);
+        }
+        textCache.clear();
+        textIndex.clear();
     }
     
     pair<int, int> screenToGrid(int mouseX, int mouseY) {
-        int col = (mouseX - GRID_OFFSET_X) / TILE_SIZE;
-        int row = (mouseY - GRID_OFFSET_Y) / TILE_SIZE;
+        if (mouseX < GRID_OFFSET_X || mouseX >= GRID_OFFSET_X + VIEW_WIDTH ||
+            mouseY < GRID_OFFSET_Y || mouseY >= GRID_OFFSET_Y + VIEW_HEIGHT) {
+            return {-1, -1};
+        }
+        int col = (mouseX - GRID_OFFSET_X + viewX) / tileSize;
+        int row = (mouseY - GRID_OFFSET_Y + viewY) / tileSize;
         
         if (row >= 0 && row < game->getRows() && col >= 0 && col < game->getCols()) {
             return {row, col};
@@ -193,13 +292,68 @@ private:
         return {-1, -1};
     }
     
+    // Keeps the viewport on the board; a board smaller than the viewport
+    // stays at its top-left corner
+    void clampView() {
+        viewX = max(0, min(viewX, game->getCols() * tileSize - VIEW_WIDTH));
+        viewY = max(0, min(viewY, game->getRows() * tileSize - VIEW_HEIGHT));
+    }
+    
+    // The largest zoom that shows the whole board, or the smallest zoom
+    // when even that is too big
+    void fitBoard() {
+        int fit = min(VIEW_WIDTH / game->getCols(), VIEW_HEIGHT / game->getRows());
+        tileSize = max(MIN_TILE_SIZE, min(TILE_SIZE, fit));
+        viewX = 0;
+        viewY = 0;
+        refreshHover();
+    }
+    
+    // Zooms in (steps > 0) or out, keeping the board point under the
+    // screen position (x, y) where it is
+    void zoomAt(int steps, int x, int y) {
+        int newSize = tileSize;
+        for (int i = 0; i < abs(steps); i++) {
+            newSize = steps > 0 ? newSize + max(1, newSize / 4) : newSize - max(1, newSize / 5);
+        }
+        newSize = max(MIN_TILE_SIZE, min(TILE_SIZE, newSize));
+        if (newSize == tileSize) return;
+        
+        int offsetX = x - GRID_OFFSET_X;
+        int offsetY = y - GRID_OFFSET_Y;
+        viewX = (int)((long long)(viewX + offsetX) * newSize / tileSize) - offsetX;
+        viewY = (int)((long long)(viewY + offsetY) * newSize / tileSize) - offsetY;
+        tileSize = newSize;
+        clampView();
+        refreshHover();
+    }
+    
+    void scrollBy(int dx, int dy) {
+        viewX += dx;
+        viewY += dy;
+        clampView();
+        refreshHover();
+    }
+    
+    // The tile under the mouse changes when the board moves under it
+    void refreshHover() {
+        handleMouseMove(mouseX, mouseY);
+    }
+    
 public:
     SameGameGUI(SameGame* gameInstance) : 
         window(nullptr), renderer(nullptr), font(nullptr),
-        game(gameInstance), hoveredRow(-1), hoveredCol(-1),
-        gameOver(false), gameWon(false), lastComputerMoveTime(0) {}
+        game(gameInstance), mouseX(-1), mouseY(-1), hoveredRow(-1), hoveredCol(-1),
+        tileSize(TILE_SIZE), viewX(0), viewY(0), gameOver(false), gameWon(false), lastComputerMoveTime(0),
+        aiCancel(false), aiSearching(false), aiMoveReady(false),
+        aiMove(-1, -1), aiMoveEvent((Uint32)-1),
+        ponderCancel(false), pondering(false) {
+        fitBoard();
+    }
     
     ~SameGameGUI() {
+        stopPondering();
+        cancelComputerSearch();
         cleanup();
     }
     
@@ -214,6 +368,12 @@ public:
             return false;
         }
         
+        aiMoveEvent = SDL_RegisterEvents(1);
+        if (aiMoveEvent == (Uint32)-1) {
+            cerr << "Could not register AI event! SDL_Error: " << SDL_GetError() << endl;
+            return false;
+        }
+        
         window = SDL_CreateWindow("Same Game", 
                                   SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                   WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
@@ -238,6 +398,7 @@ public:
     }
     
     void cleanup() {
+        clearTextCache();
         if (font) {
             TTF_CloseFont(font);
             font = nullptr;
@@ -254,21 +415,15 @@ public:
         SDL_Quit();
     }
     
-    void handleMouseMove(int mouseX, int mouseY) {
-        pair<int, int> pos = screenToGrid(mouseX, mouseY);
+    void handleMouseMove(int x, int y) {
+        mouseX = x;
+        mouseY = y;
+        pair<int, int> pos = screenToGrid(x, y);
         int row = pos.first;
         int col = pos.second;
         
-        if (row != hoveredRow || col != hoveredCol) {
-            hoveredRow = row;
-            hoveredCol = col;
-            
-            if (row >= 0 && col >= 0 && game->isTileActive(row, col)) {
-                hoveredCluster = game->getCluster(row, col);
-            } else {
-                hoveredCluster.clear();
-            }
-        }
+        hoveredRow = row;
+        hoveredCol = col;
     }
     
     void handleMouseClick(int mouseX, int mouseY) {
@@ -278,11 +433,9 @@ public:
         int row = pos.first;
         int col = pos.second;
         
-        if (row >= 0 && col >= 0) {
+        if (row >= 0 && col >= 0 && game->getClusterSize(row, col) >= 2) {
+            stopPondering();
             if (game->removeCluster(row, col)) {
-                // Clear hovered state after move
-                hoveredCluster.clear();
-                
                 // Check if game is over
                 if (!game->hasMovesLeft()) {
                     gameOver = true;
@@ -300,19 +453,88 @@ public:
     }
     
     void handleRestart() {
-        vector<vector<char>> initialGrid = generateRandomGrid(6, 8);
+        stopPondering();
+        cancelComputerSearch();
+        vector<vector<char>> initialGrid = generateRandomGrid(game->getRows(), game->getCols());
         game->reset(initialGrid);
         gameOver = false;
         gameWon = false;
-        hoveredCluster.clear();
+        fitBoard();
         lastComputerMoveTime = SDL_GetTicks();
     }
     
+    // Starts searching for the computer's move on a worker thread
+    void startComputerSearch() {
+        aiCancel.store(false);
+        aiSearching = true;
+        aiMoveReady = false;
+        
+        // The worker owns its copy of the position (the game's scratch and
+        // caches aren't copied); only the transposition table is shared
+        aiThread = thread([this, snapshot = *game]() mutable {
+            snapshot.setStopSignal(&aiCancel);
+            pair<int, int> move = snapshot.getBestMove();
+            if (aiCancel.load()) return;
+            
+            SDL_Event done;
+            SDL_zero(done);
+            done.type = aiMoveEvent;
+            done.user.code = move.first >= 0 ? move.first * snapshot.getCols() + move.second : -1;
+            SDL_PushEvent(&done);
+        });
+    }
+    
+    // Searches the computer's answers to the likely user moves until the
+    // user moves
+    void startPondering() {
+        ponderCancel.store(false);
+        pondering = true;
+        
+        ponderThread = thread([this, snapshot = *game]() mutable {
+            SearchLimits untilStopped = snapshot.getSearchLimits();
+            untilStopped.timeMs = 0;
+            untilStopped.maxNodes = 0;
+            snapshot.setSearchLimits(untilStopped);
+            snapshot.setStopSignal(&ponderCancel);
+            snapshot.ponder();
+        });
+    }
+    
+    void stopPondering() {
+        if (ponderThread.joinable()) {
+            ponderCancel.store(true);
+            ponderThread.join();
+        }
+        pondering = false;
+    }
+    
+    // Stops a running search and drops its result, if any
+    void cancelComputerSearch() {
+        if (aiThread.joinable()) {
+            aiCancel.store(true);
+            aiThread.join();
+        }
+        if (aiMoveEvent != (Uint32)-1) {
+            SDL_FlushEvent(aiMoveEvent);
+        }
+        aiSearching = false;
+        aiMoveReady = false;
+    }
+    
+    void handleSearchDone(const SDL_Event& e) {
+        aiThread.join();
+        aiSearching = false;
+        aiMoveReady = true;
+        int cell = e.user.code;
+        aiMove = cell >= 0 ? make_pair(cell / game->getCols(), cell % game->getCols())
+                           : make_pair(-1, -1);
+    }
+    
     void executeComputerMove() {
-        if (gameOver || game->getUserTurn()) return;
+        if (gameOver || game->getUserTurn() || !aiMoveReady) return;
         
-        // Get the best move using sorting + DP lookahead
-        pair<int, int> bestMove = game->getBestMove();
+        pair<int, int> bestMove = aiMove;
+        aiMoveReady = false;
         
         if (bestMove.first != -1 && bestMove.second != -1) {
             // Execute the move
@@ -350,42 +572,94 @@ public:
         SDL_Event e;
         
         while (!quit) {
+            Uint32 frameStart = SDL_GetTicks();
+            
             while (SDL_PollEvent(&e) != 0) {
                 if (e.type == SDL_QUIT) {
                     quit = true;
+                } else if (e.type == aiMoveEvent) {
+                    handleSearchDone(e);
                 } else if (e.type == SDL_MOUSEMOTION) {
+                    // Dragging with the right or middle button pans
+                    if (e.motion.state & (SDL_BUTTON_RMASK | SDL_BUTTON_MMASK)) {
+                        scrollBy(-e.motion.xrel, -e.motion.yrel);
+                    }
                     handleMouseMove(e.motion.x, e.motion.y);
                 } else if (e.type == SDL_MOUSEBUTTONDOWN) {
                     if (e.button.button == SDL_BUTTON_LEFT) {
                         handleMouseClick(e.button.x, e.button.y);
                     }
+                } else if (e.type == SDL_MOUSEWHEEL) {
+                    zoomAt(e.wheel.y, mouseX, mouseY);
                 } else if (e.type == SDL_KEYDOWN) {
-                    if (e.key.keysym.sym == SDLK_r) {
-                        handleRestart();
-                    } else if (e.key.keysym.sym == SDLK_ESCAPE) {
-                        quit = true;
+                    int centerX = GRID_OFFSET_X + VIEW_WIDTH / 2;
+                    int centerY = GRID_OFFSET_Y + VIEW_HEIGHT / 2;
+                    switch (e.key.keysym.sym) {
+                        case SDLK_r: handleRestart(); break;
+                        case SDLK_ESCAPE:
+                            stopPondering();
+                            cancelComputerSearch();
+                            quit = true;
+                            break;
+                        case SDLK_PLUS: case SDLK_EQUALS: case SDLK_KP_PLUS:
+                            zoomAt(1, centerX, centerY);
+                            break;
+                        case SDLK_MINUS: case SDLK_KP_MINUS:
+                            zoomAt(-1, centerX, centerY);
+                            break;
+                        case SDLK_f: case SDLK_HOME: fitBoard(); break;
+                        case SDLK_LEFT: scrollBy(-SCROLL_STEP, 0); break;
+                        case SDLK_RIGHT: scrollBy(SCROLL_STEP, 0); break;
+                        case SDLK_UP: scrollBy(0, -SCROLL_STEP); break;
+                        case SDLK_DOWN: scrollBy(0, SCROLL_STEP); break;
                     }
                 }
             }
             
-            // Execute computer move if it's computer's turn and enough time has passed
+            if (!gameOver && game->getUserTurn() && !pondering) {
+                startPondering();
+            }
+            
+            // Search as soon as it is the computer's turn; play the result
+            // once it has arrived and enough time has passed
             if (!gameOver && !game->getUserTurn()) {
+                if (!aiSearching && !aiMoveReady) {
+                    startComputerSearch();
+                }
                 Uint32 currentTime = SDL_GetTicks();
-                if (currentTime - lastComputerMoveTime >= COMPUTER_MOVE_DELAY) {
+                if (aiMoveReady && currentTime - lastComputerMoveTime >= COMPUTER_MOVE_DELAY) {
                     executeComputerMove();
                     lastComputerMoveTime = currentTime;
                 }
             }
             
             render();
-            SDL_Delay(16); // ~60 FPS
+            
+            Uint32 frameTime = SDL_GetTicks() - frameStart;
+            if (frameTime < FRAME_MS) {
+                SDL_Delay(FRAME_MS - frameTime);
+            }
         }
+        stopPondering();
+        cancelComputerSearch();
     }
 };
 
 int main(int argc, char* argv[]) {
+    // samegame [rows cols]
+    int rows = DEFAULT_ROWS;
+    int cols = DEFAULT_COLS;
+    if (argc == 3) {
+        rows = atoi(argv[1]);
+        cols = atoi(argv[2]);
+    }
+    if ((argc != 1 && argc != 3) || rows <= 0 || cols <= 0) {
+        cerr << "Usage: samegame [rows cols]" << endl;
+        return 1;
+    }
+    
     // Initialize game with random grid
-    vector<vector<char>> initialGrid = generateRandomGrid(6, 8);
+    vector<vector<char>> initialGrid = generateRandomGrid(rows, cols);
     
     SameGame game(initialGrid);
     SameGameGUI gui(&game);
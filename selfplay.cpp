@@ -0,0 +1,233 @@
+// Headless self-play: plays many seeded games across a pool of worker threads
+// and reports engine throughput, decision latency and score distributions.
+//
+//   selfplay [--games N] [--threads T] [--rows R] [--cols C] [--colors K]
+//            [--seed S] [--opponent ai|random|greedy]
+//            [--engine alphabeta|mcts] [--time-ms M] [--nodes N]
+//            [--depth D] [--search-threads T] [--solve-tiles N]
+//            [--first opponent|engine]
+//
+// The engine plays the computer's side. By default the opponent moves first,
+// as the user does in the GUI.
+#include "SameGame.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+enum class Opponent {
+    AI,
+    Random,
+    Greedy
+};
+
+struct Options {
+    int games = 100;
+    int threads = (int)max(1u, thread::hardware_concurrency());
+    int rows = 6;
+    int cols = 8;
+    int colors = 5;
+    uint64_t seed = 1;
+    Opponent opponent = Opponent::Greedy;
+    bool engineFirst = false;
+    SearchLimits limits;
+};
+
+struct GameResult {
+    long long engineScore;
+    long long opponentScore;
+    int moves;
+    int tilesLeft;
+    vector<double> latenciesMs;  // one per engine decision
+};
+
+uint64_t nextRandom(uint64_t& state) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+}
+
+vector<vector<char>> makeGrid(const Options& opt, uint64_t seed) {
+    static const char COLORS[] = {'G', 'W', 'R', 'B', 'Y', 'C', 'M', 'O'};
+    uint64_t state = seed;
+    vector<vector<char>> grid(opt.rows, vector<char>(opt.cols));
+    for (auto& row : grid) {
+        for (char& tile : row) {
+            tile = COLORS[nextRandom(state) % opt.colors];
+        }
+    }
+    return grid;
+}
+
+pair<int, int> baselineMove(SameGame& game, Opponent kind, uint64_t& rng) {
+    vector<tuple<int, char, int, int>> clusters = game.getAllClusters();
+    size_t pick = 0;
+    if (kind == Opponent::Random) {
+        pick = nextRandom(rng) % clusters.size();
+    } else {
+        for (size_t i = 1; i < clusters.size(); i++) {
+            if (get<0>(clusters[i]) > get<0>(clusters[pick])) pick = i;
+        }
+    }
+    return {get<2>(clusters[pick]), get<3>(clusters[pick])};
+}
+
+GameResult playGame(const Options& opt, int index) {
+    uint64_t seed = opt.seed + (uint64_t)index * 0x9E3779B97F4A7C15ULL;
+    SameGame game(makeGrid(opt, seed));
+    game.setSearchLimits(opt.limits);
+    if (opt.engineFirst) game.switchTurn();
+    uint64_t rng = seed ^ 0xD1B54A32D192ED03ULL;
+
+    GameResult result = {};
+    while (game.hasMovesLeft()) {
+        pair<int, int> move;
+        if (!game.getUserTurn() || opt.opponent == Opponent::AI) {
+            auto start = chrono::steady_clock::now();
+            move = game.getBestMove();
+            result.latenciesMs.push_back(chrono::duration<double, milli>(
+                chrono::steady_clock::now() - start).count());
+        } else {
+            move = baselineMove(game, opt.opponent, rng);
+        }
+        game.removeCluster(move.first, move.second);
+    }
+
+    result.engineScore = game.getComputerScore();
+    result.opponentScore = game.getUserScore();
+    result.moves = game.getMoves();
+    for (int i = 0; i < game.getRows(); i++) {
+        for (int j = 0; j < game.getCols(); j++) {
+            if (game.isTileActive(i, j)) result.tilesLeft++;
+        }
+    }
+    return result;
+}
+
+// Value at fraction `q` of a sorted sample
+double percentile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    return sorted[min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+void printDistribution(const string& label, vector<double> values) {
+    sort(values.begin(), values.end());
+    double mean = values.empty() ? 0 : accumulate(values.begin(), values.end(), 0.0) / values.size();
+    cout << left << setw(16) << label << right << fixed << setprecision(1)
+         << " mean " << setw(8) << mean
+         << "  min " << setw(6) << percentile(values, 0)
+         << "  p25 " << setw(6) << percentile(values, 0.25)
+         << "  p50 " << setw(6) << percentile(values, 0.5)
+         << "  p75 " << setw(6) << percentile(values, 0.75)
+         << "  max " << setw(6) << (values.empty() ? 0 : values.back()) << endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--games") opt.games = atoi(value.c_str());
+        else if (arg == "--threads") opt.threads = max(1, atoi(value.c_str()));
+        else if (arg == "--rows") opt.rows = atoi(value.c_str());
+        else if (arg == "--cols") opt.cols = atoi(value.c_str());
+        else if (arg == "--colors") opt.colors = min(8, max(1, atoi(value.c_str())));
+        else if (arg == "--seed") opt.seed = strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--time-ms") opt.limits.timeMs = atoi(value.c_str());
+        else if (arg == "--nodes") opt.limits.maxNodes = atoll(value.c_str());
+        else if (arg == "--depth") opt.limits.maxDepth = atoi(value.c_str());
+        else if (arg == "--solve-tiles") opt.limits.solveTiles = atoi(value.c_str());
+        else if (arg == "--search-threads") opt.limits.threads = max(1, atoi(value.c_str()));
+        else if (arg == "--first") opt.engineFirst = value == "engine";
+        else if (arg == "--opponent") {
+            if (value == "ai") opt.opponent = Opponent::AI;
+            else if (value == "random") opt.opponent = Opponent::Random;
+            else if (value == "greedy") opt.opponent = Opponent::Greedy;
+            else { cerr << "Unknown opponent " << value << endl; return false; }
+        } else if (arg == "--engine") {
+            if (value == "alphabeta") opt.limits.engine = SearchEngine::AlphaBeta;
+            else if (value == "mcts") opt.limits.engine = SearchEngine::MonteCarlo;
+            else { cerr << "Unknown engine " << value << endl; return false; }
+        } else {
+            cerr << "Unknown option " << arg << endl;
+            return false;
+        }
+    }
+    return opt.games > 0 && opt.rows > 0 && opt.cols > 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    opt.limits.timeMs = 50;
+    if (!parseOptions(argc, argv, opt)) {
+        cerr << "Usage: selfplay [--games N] [--threads T] [--rows R] [--cols C] [--colors K] [--seed S]\n"
+             << "                [--opponent ai|random|greedy] [--engine alphabeta|mcts]\n"
+             << "                [--time-ms M] [--nodes N] [--depth D] [--search-threads T]\n"
+             << "                [--solve-tiles N] [--first opponent|engine]" << endl;
+        return 1;
+    }
+
+    // Games are handed out one at a time so slow games do not stall a worker
+    vector<GameResult> results(opt.games);
+    atomic<int> nextGame(0);
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int t = 0; t < min(opt.threads, opt.games); t++) {
+        pool.emplace_back([&] {
+            for (int g = nextGame++; g < opt.games; g = nextGame++) {
+                results[g] = playGame(opt, g);
+            }
+        });
+    }
+    for (thread& worker : pool) worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    long long totalMoves = 0;
+    int wins = 0, draws = 0, cleared = 0;
+    vector<double> latencies, engineScores, opponentScores, margins;
+    for (const GameResult& r : results) {
+        totalMoves += r.moves;
+        wins += r.engineScore > r.opponentScore;
+        draws += r.engineScore == r.opponentScore;
+        cleared += r.tilesLeft == 0;
+        latencies.insert(latencies.end(), r.latenciesMs.begin(), r.latenciesMs.end());
+        engineScores.push_back(r.engineScore);
+        opponentScores.push_back(r.opponentScore);
+        margins.push_back(r.engineScore - r.opponentScore);
+    }
+    sort(latencies.begin(), latencies.end());
+    double meanLatency = latencies.empty() ? 0 : accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+
+    const char* opponentName[] = {"ai", "random", "greedy"};
+    cout << "Self-play: " << opt.games << " games on " << opt.rows << "x" << opt.cols
+         << " (" << opt.colors << " colors), " << opt.threads << " workers, "
+         << (opt.limits.engine == SearchEngine::MonteCarlo ? "mcts" : "alphabeta")
+         << " vs " << opponentName[(int)opt.opponent]
+         << (opt.engineFirst ? ", engine first" : ", opponent first") << endl;
+    cout << fixed << setprecision(2);
+    cout << "Time:            " << seconds << " s" << endl;
+    cout << "Games/sec:       " << opt.games / seconds << endl;
+    cout << "Moves/sec:       " << totalMoves / seconds << endl;
+    cout << "Decisions:       " << latencies.size() << endl;
+    cout << "Latency (ms):    mean " << meanLatency
+         << "  p50 " << percentile(latencies, 0.5)
+         << "  p99 " << percentile(latencies, 0.99)
+         << "  max " << (latencies.empty() ? 0 : latencies.back()) << endl;
+    cout << "Engine results:  " << wins << " won, " << draws << " drawn, "
+         << opt.games - wins - draws << " lost, " << cleared << " boards cleared" << endl;
+    printDistribution("Engine score", engineScores);
+    printDistribution("Opponent score", opponentScores);
+    printDistribution("Margin", margins);
+
+    return 0;
+}
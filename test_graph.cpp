@@ -1,9 +1,61 @@
 #include "SameGame.h"
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 
+// Deterministic board so backend comparisons are reproducible
+vector<vector<char>> makeSeededGrid(int rows, int cols, unsigned seed) {
+    const char colors[] = {'G', 'W', 'R', 'B', 'Y'};
+    vector<vector<char>> grid(rows, vector<char>(cols));
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            seed = seed * 1103515245u + 12345u;
+            grid[i][j] = colors[(seed >> 16) % 5];
+        }
+    }
+    return grid;
+}
+
+// Wall-clock checks allow this many times the time limit: sanitizer builds
+// run several times slower. The budgets themselves are checked through node
+// counts and depths.
+const long long CLOCK_SLACK = 10;
+
+long long millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start).count();
+}
+
+bool sameBoard(const SameGame& a, const SameGame& b) {
+    for (int i = 0; i < a.getRows(); i++) {
+        for (int j = 0; j < a.getCols(); j++) {
+            if (a.isTileActive(i, j) != b.isTileActive(i, j)) return false;
+            if (a.isTileActive(i, j) && a.getTile(i, j) != b.getTile(i, j)) return false;
+        }
+    }
+    return true;
+}
+
+// Final computer score minus user score with best play, by full minimax
+long long bestLead(SameGame& game) {
+    vector<tuple<int, char, int, int>> clusters = game.getAllClusters();
+    if (clusters.empty()) return game.getComputerScore() - game.getUserScore();
+    bool computer = !game.getUserTurn();
+    long long best = computer ? LLONG_MIN : LLONG_MAX;
+    for (const auto& c : clusters) {
+        MoveUndo undo;
+        game.makeMove(get<2>(c), get<3>(c), undo);
+        long long lead = bestLead(game);
+        game.unmakeMove(undo);
+        best = computer ? max(best, lead) : min(best, lead);
+    }
+    return best;
+}
+
 void printGrid(SameGame& game) {
     cout << "Current Grid:" << endl;
     for (int i = 0; i < game.getRows(); i++) {
@@ -151,6 +203,631 @@ int main() {
     cout << "Computer score: " << game.getComputerScore() << endl;
     cout << "✓ User vs Computer mode test passed" << endl << endl;
     
+    // Test 11: Bitboard and graph backends agree move for move
+    cout << "Test 11: Bitboard backend matches graph backend" << endl;
+    for (unsigned seed = 1; seed <= 24; seed++) {
+        vector<vector<char>> grid = makeSeededGrid(6 + seed % 4, 8 + seed % 3, seed);
+        if (seed > 20) {
+            // Full-height columns in two colors: long runs that merge across columns
+            grid = makeSeededGrid(63, 10, seed);
+            for (auto& row : grid) {
+                for (char& tile : row) tile = tile == 'G' || tile == 'W' ? 'G' : 'R';
+            }
+        }
+        SameGame graphGame(grid, BoardBackend::Graph);
+        SameGame bitGame(grid, BoardBackend::BitBoard);
+        assert(graphGame.getBackend() == BoardBackend::Graph);
+        assert(bitGame.getBackend() == BoardBackend::BitBoard);
+
+        // Identical clusters and evaluation terms mean identical searches
+        if (seed % 5 == 0) {
+            SearchLimits fixedDepth;
+            fixedDepth.timeMs = 0;
+            fixedDepth.maxDepth = 5;
+            graphGame.setSearchLimits(fixedDepth);
+            bitGame.setSearchLimits(fixedDepth);
+            graphGame.switchTurn();
+            bitGame.switchTurn();
+            assert(graphGame.getBestMove() == bitGame.getBestMove());
+            graphGame.switchTurn();
+            bitGame.switchTurn();
+        }
+
+        while (true) {
+            assert(sameBoard(graphGame, bitGame));
+            assert(graphGame.getHash() == bitGame.getHash());
+            assert(graphGame.hasMovesLeft() == bitGame.hasMovesLeft());
+
+            vector<tuple<int, char, int, int>> a = graphGame.getAllClusters();
+            vector<tuple<int, char, int, int>> b = bitGame.getAllClusters();
+            assert(a == b); // same representatives, same order
+            vector<ClusterInfo> infoA = graphGame.getClusterInfo();
+            vector<ClusterInfo> infoB = bitGame.getClusterInfo();
+            assert(infoA.size() == infoB.size());
+            for (size_t k = 0; k < infoA.size(); k++) {
+                assert(infoA[k].minRow == infoB[k].minRow && infoA[k].maxRow == infoB[k].maxRow);
+                assert(infoA[k].minCol == infoB[k].minCol && infoA[k].maxCol == infoB[k].maxCol);
+            }
+            for (const auto& cluster : b) {
+                int row = get<2>(cluster), col = get<3>(cluster);
+                assert(graphGame.getClusterSize(row, col) == get<0>(cluster));
+                assert(bitGame.getCluster(row, col).size() == (size_t)get<0>(cluster));
+            }
+            if (b.empty()) break;
+
+            // Play the middle cluster so games don't only eat the left edge
+            const auto& move = b[b.size() / 2];
+            assert(graphGame.removeCluster(get<2>(move), get<3>(move)));
+            assert(bitGame.removeCluster(get<2>(move), get<3>(move)));
+            assert(graphGame.getScore() == bitGame.getScore());
+        }
+    }
+    assert(SameGame(grid1).getBackend() == BoardBackend::Graph);
+    cout << "✓ Backend equivalence test passed" << endl << endl;
+
+    // Test 12: Zobrist hash follows the position, not the move order
+    cout << "Test 12: Zobrist hashing" << endl;
+    vector<vector<char>> grid3 = {
+        {'G', 'G', 'W', 'R', 'R'},
+        {'B', 'Y', 'W', 'B', 'Y'}
+    };
+    for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+        SameGame first(grid3, backend);
+        SameGame second(grid3, backend);
+        assert(first.getHash() == second.getHash());
+
+        first.removeCluster(0, 0);
+        first.removeCluster(0, 3);
+        second.removeCluster(0, 3);
+        second.removeCluster(0, 0);
+        assert(sameBoard(first, second));
+        assert(first.getHash() == second.getHash());
+
+        uint64_t before = first.getHash();
+        first.switchTurn();
+        assert(first.getHash() != before);
+        first.switchTurn();
+        assert(first.getHash() == before);
+    }
+    cout << "✓ Zobrist hashing test passed" << endl << endl;
+
+    // Test 13: Fixed-size transposition table
+    cout << "Test 13: Transposition table replacement policy" << endl;
+    TranspositionTable tt(1);
+    assert(tt.capacity() == 0); // nothing reserved before the first search
+    tt.newSearch();
+    size_t buckets = tt.capacity() / 2;
+    assert(buckets > 0 && (buckets & (buckets - 1)) == 0);
+    assert(tt.capacity() * sizeof(TTEntry) <= tt.budget());
+
+    auto makeEntry = [](uint64_t key, int depth) {
+        TTEntry e = {};
+        e.key = key;
+        e.value = depth * 10;
+        e.bestMove = -1;
+        e.depth = depth;
+        return e;
+    };
+    uint64_t keyA = 12345, keyB = keyA + buckets, keyC = keyA + 2 * buckets;
+    tt.store(makeEntry(keyA, 5));
+    tt.store(makeEntry(keyB, 3)); // shallower: goes to the always-replace slot
+    TTEntry hit;
+    assert(tt.probe(keyA, hit) && hit.depth == 5 && hit.value == 50);
+    assert(tt.probe(keyB, hit) && hit.depth == 3);
+    tt.store(makeEntry(keyC, 2));
+    assert(tt.probe(keyA, hit) && tt.probe(keyC, hit) && !tt.probe(keyB, hit));
+    tt.newSearch();
+    tt.store(makeEntry(keyB, 1)); // deep slot is from an older search
+    assert(tt.probe(keyB, hit) && !tt.probe(keyA, hit));
+
+    // The game keeps its table across turns and still plays legal moves
+    SameGame ttGame(makeSeededGrid(6, 8, 7));
+    ttGame.setTranspositionTableSize(1);
+    SearchLimits quick;
+    quick.timeMs = 50;
+    ttGame.setSearchLimits(quick);
+    ttGame.removeCluster(get<2>(ttGame.getAllClusters()[0]), get<3>(ttGame.getAllClusters()[0]));
+    for (int turn = 0; turn < 3 && ttGame.hasMovesLeft(); turn++) {
+        pair<int, int> move = ttGame.getBestMove();
+        assert(ttGame.getClusterSize(move.first, move.second) >= 2);
+        assert(ttGame.removeCluster(move.first, move.second));
+        if (ttGame.hasMovesLeft()) {
+            vector<tuple<int, char, int, int>> options = ttGame.getAllClusters();
+            ttGame.removeCluster(get<2>(options[0]), get<3>(options[0]));
+        }
+    }
+    cout << "✓ Transposition table test passed" << endl << endl;
+
+    // Test 14: makeMove / unmakeMove restore the position exactly
+    cout << "Test 14: Make and unmake moves" << endl;
+    for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+        for (unsigned seed = 30; seed < 40; seed++) {
+            SameGame live(makeSeededGrid(5 + seed % 3, 6 + seed % 4, seed), backend);
+            SameGame reference(makeSeededGrid(5 + seed % 3, 6 + seed % 4, seed), backend);
+            vector<MoveUndo> history;
+            while (live.hasMovesLeft()) {
+                vector<tuple<int, char, int, int>> options = live.getAllClusters();
+                const auto& move = options[(seed + history.size()) % options.size()];
+                SameGame before = live;
+                history.emplace_back();
+                assert(live.makeMove(get<2>(move), get<3>(move), history.back()));
+
+                // Columns outside the reported range are untouched
+                const MoveUndo& undo = history.back();
+                assert(undo.firstChangedCol <= get<3>(move) && get<3>(move) <= undo.lastChangedCol);
+                for (int j = 0; j < live.getCols(); j++) {
+                    if (j >= undo.firstChangedCol && j <= undo.lastChangedCol) continue;
+                    for (int i = 0; i < live.getRows(); i++) {
+                        assert(live.isTileActive(i, j) == before.isTileActive(i, j));
+                        assert(live.getTile(i, j) == before.getTile(i, j) || !live.isTileActive(i, j));
+                    }
+                }
+                assert(reference.removeCluster(get<2>(move), get<3>(move)));
+                assert(sameBoard(live, reference) && live.getHash() == reference.getHash());
+            }
+            // Take everything back, one move at a time
+            SameGame fresh(makeSeededGrid(5 + seed % 3, 6 + seed % 4, seed), backend);
+            while (!history.empty()) {
+                live.unmakeMove(history.back());
+                history.pop_back();
+            }
+            assert(sameBoard(live, fresh) && live.getHash() == fresh.getHash());
+            assert(live.getScore() == 0 && live.getMoves() == 0 && live.getUserTurn());
+            assert(live.getUserScore() == 0 && live.getComputerScore() == 0);
+            assert(live.getAllClusters().size() == fresh.getAllClusters().size());
+        }
+    }
+    cout << "✓ Make/unmake test passed" << endl << endl;
+
+    // Test 15: Cluster labelling reports sizes and bounding boxes
+    cout << "Test 15: Cluster labelling" << endl;
+    for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+        SameGame labelled(grid1, backend);
+        vector<ClusterInfo> infos = labelled.getClusterInfo();
+        assert(infos.size() == 3);
+        for (const ClusterInfo& info : infos) {
+            assert(labelled.getTile(info.row, info.col) == info.color);
+            assert(labelled.getClusterSize(info.row, info.col) == info.size);
+            if (info.color == 'W') {
+                assert(info.size == 6);
+                assert(info.minRow == 0 && info.maxRow == 2);
+                assert(info.minCol == 0 && info.maxCol == 2);
+                assert(info.row == 2 && info.col == 0);
+            } else if (info.color == 'G') {
+                assert(info.minRow == 0 && info.maxRow == 1 && info.maxCol == 1);
+            } else {
+                assert(info.color == 'R' && info.minCol == 3 && info.maxCol == 3);
+            }
+        }
+    }
+    cout << "✓ Cluster labelling test passed" << endl << endl;
+
+    // Test 16: Iterative deepening respects its budgets
+    cout << "Test 16: Time- and node-budgeted search" << endl;
+    {
+        SameGame big(makeSeededGrid(15, 15, 99));
+        big.switchTurn();
+        SearchLimits timed;
+        timed.timeMs = 50;
+        big.setSearchLimits(timed);
+        auto start = chrono::steady_clock::now();
+        pair<int, int> move = big.getBestMove();
+        long long elapsed = millisSince(start);
+        cout << "15x15 search: depth " << big.getLastSearchDepth() << " in " << elapsed << " ms" << endl;
+        assert(big.getClusterSize(move.first, move.second) >= 2);
+        assert(elapsed < timed.timeMs * CLOCK_SLACK);
+
+        // A stop signal raised before the search still gets a legal move
+        atomic<bool> stop(true);
+        SameGame stopped(makeSeededGrid(15, 15, 99));
+        stopped.switchTurn();
+        stopped.setSearchLimits(timed);
+        stopped.setStopSignal(&stop);
+        move = stopped.getBestMove();
+        assert(stopped.getClusterSize(move.first, move.second) >= 2);
+        assert(stopped.getLastSearchDepth() == 0);
+
+        // A node budget makes the search reproducible
+        SearchLimits counted;
+        counted.timeMs = 0;
+        counted.maxNodes = 20000;
+        big.setSearchLimits(counted);
+        big.getBestMove();
+        assert(big.getLastSearchDepth() >= 1);
+        assert(big.getLastSearchNodes() <= counted.maxNodes + 1000);
+        SameGame a(makeSeededGrid(8, 8, 5)), b(makeSeededGrid(8, 8, 5));
+        a.switchTurn();
+        b.switchTurn();
+        a.setSearchLimits(counted);
+        b.setSearchLimits(counted);
+        assert(a.getBestMove() == b.getBestMove());
+        assert(a.getLastSearchDepth() == b.getLastSearchDepth());
+
+        // Small endgames are solved outright instead of running to maxDepth
+        vector<vector<char>> tiny = {{'G', 'G', 'R'}, {'R', 'R', 'G'}};
+        SameGame endgame(tiny);
+        endgame.switchTurn();
+        endgame.setSearchLimits(counted);
+        endgame.getBestMove();
+        assert(endgame.getLastSearchDepth() <= 3);
+
+        // On the user's turn the search picks the user's best move
+        SameGame hint(vector<vector<char>>{{'R', 'R', 'G', 'G', 'G', 'G'}});
+        assert(hint.getBestMove() == make_pair(0, 2));
+    }
+    cout << "✓ Budgeted search test passed" << endl << endl;
+
+    // Test 17: Lazy SMP shares one lock-free table between threads
+    cout << "Test 17: Multi-threaded search" << endl;
+    {
+        // Concurrent writers never leave an entry that reads back torn
+        TranspositionTable shared(1);
+        shared.newSearch();
+        vector<thread> writers;
+        for (int t = 0; t < 4; t++) {
+            writers.emplace_back([&shared, t] {
+                TTEntry e = {};
+                for (int i = 0; i < 200000; i++) {
+                    uint64_t key = (uint64_t)(i % 5000) * 0x9E3779B97F4A7C15ULL;
+                    e.key = key;
+                    e.value = (int)(key >> 40);
+                    e.bestMove = (int)(key >> 48);
+                    e.depth = (int16_t)(t + i % 7);
+                    shared.store(e);
+                    TTEntry seen;
+                    if (shared.probe(key, seen)) {
+                        assert(seen.value == (int)(key >> 40));
+                        assert(seen.bestMove == (int)(key >> 48));
+                    }
+                }
+            });
+        }
+        for (thread &w : writers) w.join();
+
+        SearchLimits parallel;
+        parallel.timeMs = 0;
+        parallel.maxNodes = 20000;
+        parallel.threads = 4;
+        SameGame smp(makeSeededGrid(10, 10, 31));
+        smp.switchTurn();
+        smp.setSearchLimits(parallel);
+        for (int turn = 0; turn < 3 && smp.hasMovesLeft(); turn++) {
+            pair<int, int> move = smp.getBestMove();
+            assert(smp.getClusterSize(move.first, move.second) >= 2);
+            assert(smp.getLastSearchDepth() >= 1);
+            smp.removeCluster(move.first, move.second);
+        }
+        cout << "4 threads reached depth " << smp.getLastSearchDepth() << endl;
+
+        // One thread with a node budget stays reproducible
+        SearchLimits single;
+        single.timeMs = 0;
+        single.maxNodes = 20000;
+        single.threads = 1;
+        SameGame c(makeSeededGrid(8, 8, 5)), d(makeSeededGrid(8, 8, 5));
+        c.switchTurn();
+        d.switchTurn();
+        c.setSearchLimits(single);
+        d.setSearchLimits(single);
+        assert(c.getBestMove() == d.getBestMove());
+
+        // A cancelled search returns at once with a legal fallback move
+        atomic<bool> cancel(true);
+        SameGame cancelled(makeSeededGrid(10, 10, 31));
+        cancelled.switchTurn();
+        cancelled.setStopSignal(&cancel);
+        pair<int, int> fallback = cancelled.getBestMove();
+        assert(cancelled.getClusterSize(fallback.first, fallback.second) >= 2);
+        assert(cancelled.getLastSearchDepth() == 0);
+    }
+    cout << "✓ Multi-threaded search test passed" << endl << endl;
+
+    // Test 18: Pondering leaves the answer to the user's move in the table
+    cout << "Test 18: Pondering" << endl;
+    {
+        SameGame live(makeSeededGrid(6, 8, 21)), cold(makeSeededGrid(6, 8, 21));
+        SearchLimits pondering;
+        pondering.timeMs = 200;
+        SameGame thinker(live); // shares live's transposition table
+        thinker.setSearchLimits(pondering);
+        thinker.ponder(100);    // every reply on this small board
+
+        SearchLimits instant;
+        instant.timeMs = 0;
+        instant.maxNodes = 1;
+        live.setSearchLimits(instant);
+        cold.setSearchLimits(instant);
+        vector<tuple<int, char, int, int>> options = live.getAllClusters();
+        live.removeCluster(get<2>(options[0]), get<3>(options[0]));
+        cold.removeCluster(get<2>(options[0]), get<3>(options[0]));
+
+        pair<int, int> answer = live.getBestMove();
+        cold.getBestMove();
+        cout << "Pondered depth " << live.getLastSearchDepth() << endl;
+        assert(live.getClusterSize(answer.first, answer.second) >= 2);
+        assert(live.getLastSearchDepth() >= 1);
+        assert(cold.getLastSearchDepth() == 0);
+    }
+    cout << "✓ Pondering test passed" << endl << endl;
+
+    // Test 19: Monte Carlo engine
+    cout << "Test 19: Monte Carlo tree search" << endl;
+    {
+        SearchLimits mcts;
+        mcts.engine = SearchEngine::MonteCarlo;
+        mcts.timeMs = 100;
+        SameGame wide(makeSeededGrid(20, 20, 3));
+        wide.switchTurn();
+        wide.setSearchLimits(mcts);
+        auto start = chrono::steady_clock::now();
+        pair<int, int> move = wide.getBestMove();
+        long long elapsed = millisSince(start);
+        cout << "20x20 MCTS: tree depth " << wide.getLastSearchDepth() << ", "
+             << wide.getSearchTreeSize() << " nodes in " << elapsed << " ms" << endl;
+        assert(wide.getClusterSize(move.first, move.second) >= 2);
+        assert(elapsed < mcts.timeMs * CLOCK_SLACK);
+
+        // A playout budget is reproducible, and the tree respects its cap
+        mcts.timeMs = 0;
+        mcts.maxNodes = 3000;
+        mcts.treeMB = 1;
+        SameGame e(makeSeededGrid(10, 10, 8)), f(makeSeededGrid(10, 10, 8));
+        e.switchTurn();
+        f.switchTurn();
+        e.setSearchLimits(mcts);
+        f.setSearchLimits(mcts);
+        SearchStats playouts;
+        e.setSearchStats(&playouts);
+        assert(e.getBestMove() == f.getBestMove());
+        e.setSearchStats(nullptr);
+        assert(playouts.nodes == e.getLastSearchNodes());
+        assert(e.getLastSearchNodes() == f.getLastSearchNodes());
+        assert(e.getLastSearchNodes() > 0 && e.getLastSearchNodes() <= mcts.maxNodes);
+        assert(e.getSearchTreeSize() <= (1 << 20) / 32);
+
+        // The subtree for the move played and the reply to it is kept
+        SameGame g(makeSeededGrid(6, 8, 4));
+        g.switchTurn();
+        g.setSearchLimits(mcts);
+        move = g.getBestMove();
+        g.removeCluster(move.first, move.second);
+        vector<tuple<int, char, int, int>> replies = g.getAllClusters();
+        g.removeCluster(get<2>(replies[0]), get<3>(replies[0]));
+        atomic<bool> noPlayouts(true);
+        g.setStopSignal(&noPlayouts);
+        move = g.getBestMove();
+        assert(g.getClusterSize(move.first, move.second) >= 2);
+        assert(g.getSearchTreeSize() > replies.size() + 1);
+    }
+    cout << "✓ Monte Carlo test passed" << endl << endl;
+
+    // Test 20: Search statistics
+    cout << "Test 20: Search statistics" << endl;
+    {
+        SearchLimits counted;
+        counted.timeMs = 0;
+        counted.maxNodes = 20000;
+        SameGame plain(makeSeededGrid(8, 8, 5)), measured(makeSeededGrid(8, 8, 5));
+        plain.switchTurn();
+        measured.switchTurn();
+        plain.setSearchLimits(counted);
+        measured.setSearchLimits(counted);
+        SearchStats stats;
+        measured.setSearchStats(&stats);
+
+        // Instrumentation does not change what the search does
+        assert(plain.getBestMove() == measured.getBestMove());
+        assert(stats.nodes == measured.getLastSearchNodes());
+        assert(stats.nodes == plain.getLastSearchNodes());
+        assert(stats.completedDepth == measured.getLastSearchDepth());
+        assert(stats.maxPly >= stats.completedDepth - 1);
+        assert(stats.leafEvaluations > 0 && stats.leafEvaluations < stats.nodes);
+        assert(stats.ttProbes >= stats.ttHits && stats.ttHits >= stats.ttCutoffs);
+        assert(stats.totalBetaCutoffs() > 0);
+        assert(stats.effectiveBranchingFactor() > 1);
+        assert(stats.totalTime >= stats.moveGenTime + stats.evalTime);
+        cout << "Nodes " << stats.nodes << ", EBF " << stats.effectiveBranchingFactor()
+             << ", first-move cutoffs " << stats.firstMoveCutoffRate() * 100 << "%" << endl;
+    }
+    cout << "✓ Search statistics test passed" << endl << endl;
+
+    // Test 21: Evaluation terms survive make/unmake
+    cout << "Test 21: Incremental evaluation terms" << endl;
+    {
+        SearchLimits fixed;
+        fixed.timeMs = 0;
+        fixed.maxDepth = 3;
+        for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+            // `tried` makes and unmakes a probe move before every real one;
+            // `replayed` only ever sees the real moves
+            SameGame tried(makeSeededGrid(8, 8, 21), backend);
+            SameGame replayed(makeSeededGrid(8, 8, 21), backend);
+            uint64_t rng = 21;
+            MoveUndo probe, kept;
+            for (int step = 0; step < 12 && tried.hasMovesLeft(); step++) {
+                vector<ClusterInfo> moves = tried.getClusterInfo();
+                rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+                const ClusterInfo& p = moves[(rng >> 33) % moves.size()];
+                tried.makeMove(p.row, p.col, probe);
+                tried.unmakeMove(probe);
+                rng = rng * 6364136223846793005ULL + 1442695040888963407ULL;
+                const ClusterInfo& m = moves[(rng >> 33) % moves.size()];
+                tried.makeMove(m.row, m.col, kept);
+                replayed.removeCluster(m.row, m.col);
+            }
+            assert(tried.getHash() == replayed.getHash());
+
+            // Same evaluation everywhere means the same fixed-depth search
+            tried.setSearchLimits(fixed);
+            replayed.setSearchLimits(fixed);
+            assert(tried.getBestMove() == replayed.getBestMove());
+            assert(tried.getLastSearchNodes() == replayed.getLastSearchNodes());
+        }
+    }
+    cout << "✓ Incremental evaluation test passed" << endl << endl;
+
+    // Test 22: Cached move lists don't change the search
+    cout << "Test 22: Cluster cache" << endl;
+    {
+        SearchLimits fixed;
+        fixed.timeMs = 0;
+        fixed.maxDepth = 4;
+        for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+            SameGame cold(makeSeededGrid(8, 8, 22), backend);
+            SameGame warm(makeSeededGrid(8, 8, 22), backend);
+            cold.setSearchLimits(fixed);
+            warm.setSearchLimits(fixed);
+            SearchStats first, second;
+            warm.setSearchStats(&first);
+            warm.getBestMove();
+
+            // A fresh table but the move lists from the first search
+            warm.setTranspositionTableSize(TranspositionTable::DEFAULT_MB);
+            warm.setSearchStats(&second);
+            assert(warm.getBestMove() == cold.getBestMove());
+            assert(warm.getLastSearchNodes() == cold.getLastSearchNodes());
+
+            // Transpositions are reused even within a single search
+            assert(first.clusterCacheHits > 0);
+            assert(first.clusterCacheLookups == first.nodes);
+            assert(second.clusterCacheHits > first.clusterCacheHits);
+            cout << "Cache hits: " << first.clusterCacheHits << " of " << first.clusterCacheLookups
+                 << " cold, " << second.clusterCacheHits << " of " << second.clusterCacheLookups
+                 << " warm" << endl;
+        }
+    }
+    cout << "✓ Cluster cache test passed" << endl << endl;
+
+    // Test 23: Boards far beyond the bitboard's 63 rows
+    cout << "Test 23: Large boards" << endl;
+    {
+        // Two clusters of 150 * 320 tiles, each worth more than an int holds
+        vector<vector<char>> halves(300, vector<char>(320, 'R'));
+        for (int i = 150; i < 300; i++) {
+            fill(halves[i].begin(), halves[i].end(), 'G');
+        }
+        SameGame flat(halves);
+        assert(flat.getBackend() == BoardBackend::Graph);
+        assert(SameGame(halves, BoardBackend::BitBoard).getBackend() == BoardBackend::Graph);
+        pair<int, int> move = flat.getBestMove();
+        assert(flat.getClusterSize(move.first, move.second) == 48000);
+        assert(flat.removeCluster(0, 0));
+        assert(flat.removeCluster(299, 0));
+        assert(flat.getScore() == 2 * 47998LL * 47998);
+        assert(flat.getUserScore() == flat.getComputerScore());
+
+        // The time budget holds, and moves stay cheap to make and unmake
+        SameGame big(makeSeededGrid(100, 80, 24));
+        SearchLimits limits;
+        limits.timeMs = 100;
+        big.setSearchLimits(limits);
+        MoveUndo undo;
+        for (int i = 0; i < 3; i++) {
+            auto start = chrono::steady_clock::now();
+            move = big.getBestMove();
+            assert(millisSince(start) < limits.timeMs * CLOCK_SLACK);
+            assert(big.getClusterSize(move.first, move.second) >= 2);
+            uint64_t hash = big.getHash();
+            vector<tuple<int, char, int, int>> clusters = big.getAllClusters();
+            for (size_t c = 0; c < clusters.size(); c += 16) {
+                big.makeMove(get<2>(clusters[c]), get<3>(clusters[c]), undo);
+                big.unmakeMove(undo);
+            }
+            assert(big.getHash() == hash);
+            assert(big.removeCluster(move.first, move.second));
+        }
+    }
+    cout << "✓ Large board test passed" << endl << endl;
+
+    // Test 24: The label map agrees with flood fill and follows moves
+    cout << "Test 24: Cluster labels" << endl;
+    {
+        for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+            SameGame game(makeSeededGrid(9, 11, 25), backend);
+            while (true) {
+                const vector<int>& labels = game.getClusterLabels();
+                assert(&game.getClusterLabels() == &labels);
+                for (int i = 0; i < 9; i++) {
+                    for (int j = 0; j < 11; j++) {
+                        int label = labels[i * 11 + j];
+                        if (!game.isTileActive(i, j)) {
+                            assert(label == -1);
+                            continue;
+                        }
+                        assert(game.getLabelSize(label) == game.getClusterSize(i, j));
+                        for (const auto& tile : game.getCluster(i, j)) {
+                            assert(labels[tile.first * 11 + tile.second] == label);
+                        }
+                    }
+                }
+                vector<tuple<int, char, int, int>> clusters = game.getAllClusters();
+                if (clusters.empty()) break;
+                assert(game.removeCluster(get<2>(clusters[0]), get<3>(clusters[0])));
+            }
+            assert(game.getLabelSize(-1) == 0);
+        }
+    }
+    cout << "✓ Cluster label test passed" << endl << endl;
+
+    // Test 25: The endgame solver proves the minimax result
+    cout << "Test 25: Endgame solver" << endl;
+    {
+        SearchLimits exact;
+        exact.timeMs = 0;
+        exact.solveClusters = 100;
+        for (unsigned seed = 0; seed < 12; seed++) {
+            for (BoardBackend backend : {BoardBackend::Graph, BoardBackend::BitBoard}) {
+                SameGame game(makeSeededGrid(4, 5 + seed % 2, 260 + seed), backend);
+                if (seed % 3 == 0) game.switchTurn();
+                game.setSearchLimits(exact);
+                if (game.getAllClusters().empty()) continue;
+                long long lead = bestLead(game);
+                pair<int, int> move = game.getBestMove();
+                assert(game.getLastSearchSolved());
+                assert(game.getProvenLead() == lead);
+
+                // The move is one that reaches the proven result
+                MoveUndo undo;
+                game.makeMove(move.first, move.second, undo);
+                assert(bestLead(game) == lead);
+                game.unmakeMove(undo);
+            }
+        }
+
+        // Off, and over budget: the engine plays instead
+        SameGame game(makeSeededGrid(6, 8, 26));
+        SearchLimits off = exact;
+        off.solveTiles = 0;
+        game.setSearchLimits(off);
+        game.getBestMove();
+        assert(!game.getLastSearchSolved());
+        // The failed solve and the search share one node budget
+        SearchLimits starved = exact;
+        starved.maxNodes = 1000;
+        game.setSearchLimits(starved);
+        SearchStats spent;
+        game.setSearchStats(&spent);
+        pair<int, int> move = game.getBestMove();
+        game.setSearchStats(nullptr);
+        assert(!game.getLastSearchSolved());
+        assert(game.getClusterSize(move.first, move.second) >= 2);
+        assert(game.getLastSearchNodes() > starved.maxNodes / 2);
+        assert(game.getLastSearchNodes() <= starved.maxNodes);
+        assert(spent.nodes == game.getLastSearchNodes());
+
+        game.setSearchLimits(exact);
+        SameGame copy(game); // shares the solver's table
+        game.getBestMove();
+        assert(game.getLastSearchSolved());
+        cout << "6x8 proven lead: " << game.getProvenLead() << " in "
+             << game.getLastSearchNodes() << " nodes" << endl;
+        copy.getBestMove();
+        assert(copy.getLastSearchSolved());
+        assert(copy.getProvenLead() == game.getProvenLead());
+        assert(copy.getLastSearchNodes() < game.getLastSearchNodes() / 10);
+    }
+    cout << "✓ Endgame solver test passed" << endl << endl;
+
     cout << "==================================" << endl;
     cout << "All tests passed! ✓" << endl;
     cout << "Graph-based implementation working correctly!" << endl;